@@ -0,0 +1,216 @@
+/* Regression benchmark suite for the shell's hot paths.
+
+Prints one CSV row per measurement, so results from two versions can be
+compared line by line:
+
+  latency      read, parse, launch and reap of "/usr/bin/true" through get_job and run_job
+  script       jobs per second of the mysh binary running a 10000 line script
+  parse        lines and megabytes per second through get_job on buffered input
+  setup        time to start every stage of an N stage pipeline, N = 2..64
+  cat_chain    megabytes per second through dd | cat | ... | cat > /dev/null,
+               with the cat builtin and with /bin/cat
+
+usage: benchsuite [mysh_path] [megabytes]
+*/
+#include "../jobs.h"
+#include "../getjob.h"
+#include "../runjob.h"
+#include "../jobtable.h"
+#include "benchutil.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <spawn.h>
+#include <sys/wait.h>
+
+#define LATENCY_RUNS 2000
+#define SCRIPT_LINES 10000
+#define PARSE_LINES 50000
+#define PARSE_SECONDS 1.0
+#define SETUP_RUNS 50
+#define MOST_STAGES 64
+#define CHAIN_LONGEST 8
+
+extern char **environ;
+
+static struct Command benchCommands[MOST_STAGES + 1];
+static struct Job benchJob;
+
+/* Orders two nanosecond samples for qsort */
+static int compare_long(const void *a, const void *b) {
+    long long x = *(const long long *)a;
+    long long y = *(const long long *)b;
+    return (x > y) - (x < y);
+}
+
+/* Prints one result row */
+static void report(const char *benchmark, const char *parameter, int iterations, double value, const char *unit) {
+    printf("%s,%s,%d,%.3f,%s\n", benchmark, parameter, iterations, value, unit);
+    fflush(stdout);
+}
+
+/* Times the whole shell path for one command line: reading it, parsing it,
+launching /usr/bin/true and reaping it. Reports the median and 99th percentile */
+static void bench_latency() {
+    static long long samples[LATENCY_RUNS];
+    struct Job job;
+
+    for (int i = 0; i < LATENCY_RUNS; i++) {
+        set_job_input_string("/usr/bin/true\n");
+        long long start = now_ns();
+        get_job(&job);
+        run_job(&job);
+        samples[i] = now_ns() - start;
+    }
+    qsort(samples, LATENCY_RUNS, sizeof(samples[0]), compare_long);
+    report("latency", "median", LATENCY_RUNS, samples[LATENCY_RUNS / 2] / 1000.0, "usec");
+    report("latency", "p99", LATENCY_RUNS, samples[LATENCY_RUNS * 99 / 100] / 1000.0, "usec");
+}
+
+/* Runs the mysh binary on a script of /usr/bin/true lines, so startup,
+buffered script reading and the main loop are all counted */
+static void bench_script(const char *mysh) {
+    char path[] = "/tmp/benchsuite-XXXXXX";
+    int fd = mkstemp(path);
+    FILE *script = fdopen(fd, "w");
+    char *argv[] = {(char *)mysh, path, NULL};
+    pid_t pid;
+    int status;
+
+    for (int i = 0; i < SCRIPT_LINES; i++) {
+        fputs("/usr/bin/true\n", script);
+    }
+    fclose(script);
+
+    long long start = now_ns();
+    if (posix_spawn(&pid, mysh, NULL, NULL, argv, environ) != 0) {
+        fprintf(stderr, "benchsuite: cannot run %s\n", mysh);
+        unlink(path);
+        return;
+    }
+    waitpid(pid, &status, 0);
+    double seconds = (now_ns() - start) / 1e9;
+    unlink(path);
+    report("script", "true", SCRIPT_LINES, SCRIPT_LINES / seconds, "jobs/sec");
+}
+
+/* Feeds a block of typical command lines through get_job, which reads
+each line from the buffer and parses it, until PARSE_SECONDS have passed */
+static void bench_parse() {
+    const char *line = "grep -v 'foo bar' \"a b\" < in.txt | sort -k2 -n | uniq -c > out.txt\n";
+    size_t lineLength = strlen(line);
+    char *text = malloc(lineLength * PARSE_LINES + 1);
+    long long lines = 0;
+    long long elapsed = 0;
+    struct Job job;
+
+    for (int i = 0; i < PARSE_LINES; i++) {
+        memcpy(text + i * lineLength, line, lineLength);
+    }
+    text[lineLength * PARSE_LINES] = '\0';
+
+    while (elapsed < PARSE_SECONDS * 1e9) {
+        // loading the buffer is not part of what is measured
+        set_job_input_string(text);
+        long long start = now_ns();
+        while (get_job(&job) != 1) {
+            lines += 1;
+        }
+        elapsed += now_ns() - start;
+    }
+    free(text);
+    report("parse", "lines", (int)lines, lines / (elapsed / 1e9), "lines/sec");
+    report("parse", "bytes", (int)lines, lines * lineLength / (elapsed / 1e3), "MB/sec");
+}
+
+/* Fills the benchmark job with stages running argv, after an optional first stage */
+static void build_job(int stages, char **first, int firstArgc, char **argv, int argc, char *outfile) {
+    static struct Redirection output = {REDIRECT_OUTPUT, 1, NULL, -1};
+
+    memset(&benchJob, 0, sizeof(benchJob));
+    for (int i = 0; i < stages; i++) {
+        benchCommands[i].argv = argv;
+        benchCommands[i].argc = argc;
+        benchCommands[i].num_redirections = 0;
+    }
+    if (first != NULL) {
+        benchCommands[0].argv = first;
+        benchCommands[0].argc = firstArgc;
+    }
+    benchJob.pipeline = benchCommands;
+    benchJob.num_stages = stages;
+    if (outfile != NULL) {
+        output.word = outfile;
+        benchCommands[stages - 1].redirections = &output;
+        benchCommands[stages - 1].num_redirections = 1;
+    }
+}
+
+/* Times start_job alone for pipelines of /usr/bin/true, which creates the
+pipes and launches every stage, leaving the wait out of the measurement.
+A pipeline that fails to start ends its runs, and only the runs that did start count */
+static void bench_setup() {
+    static char *trueArgv[] = {"/usr/bin/true", NULL};
+    struct JobEntry *entry;
+    char parameter[32];
+
+    for (int stages = 2; stages <= MOST_STAGES; stages *= 2) {
+        long long total = 0;
+        int runs = 0;
+
+        build_job(stages, NULL, 0, trueArgv, 1, NULL);
+        for (; runs < SETUP_RUNS; runs++) {
+            long long start = now_ns();
+            if (start_job(&benchJob, 1, &entry) != 0) {
+                break;
+            }
+            total += now_ns() - start;
+            wait_for_job(entry);
+        }
+        if (runs == 0) {
+            fprintf(stderr, "benchsuite: cannot start a %d stage pipeline\n", stages);
+            continue;
+        }
+        snprintf(parameter, sizeof(parameter), "stages=%d", stages);
+        report("setup", parameter, runs, total / 1000.0 / runs, "usec");
+    }
+}
+
+/* Pushes megabytes of zeros through chains of 1 to CHAIN_LONGEST cat stages */
+static void bench_cat_chain(int megabytes) {
+    static char *catBuiltin[] = {"cat", NULL};
+    static char *catProgram[] = {"/bin/cat", NULL};
+    char **cats[] = {catBuiltin, catProgram};
+    const char *names[] = {"builtin", "program"};
+    char count[32];
+    char *ddArgv[] = {"dd", "if=/dev/zero", "bs=64k", count, "status=none", NULL};
+    char parameter[48];
+
+    snprintf(count, sizeof(count), "count=%d", megabytes * 16);
+    for (int c = 0; c < 2; c++) {
+        for (int length = 1; length <= CHAIN_LONGEST; length *= 2) {
+            build_job(length + 1, ddArgv, 5, cats[c], 1, "/dev/null");
+            long long start = now_ns();
+            run_job(&benchJob);
+            double seconds = (now_ns() - start) / 1e9;
+            snprintf(parameter, sizeof(parameter), "%s_cats=%d", names[c], length);
+            report("cat_chain", parameter, megabytes, megabytes / seconds, "MB/sec");
+        }
+    }
+}
+
+int main(int argc, char *argv[]) {
+    const char *mysh = argc > 1 ? argv[1] : "./mysh";
+    int megabytes = argc > 2 ? atoi(argv[2]) : 512;
+
+    jobs_init(0);
+
+    printf("benchmark,parameter,iterations,value,unit\n");
+    bench_latency();
+    bench_script(mysh);
+    bench_parse();
+    bench_setup();
+    bench_cat_chain(megabytes);
+    return 0;
+}
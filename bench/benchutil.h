@@ -0,0 +1,29 @@
+#ifndef BENCHUTIL_H
+#define BENCHUTIL_H
+
+/* Timing and resource helpers shared by the benchmarks, so every one of
+them measures the same way */
+
+#include <time.h>
+#include <sys/resource.h>
+
+/* Returns the current monotonic time in nanoseconds */
+static inline long long now_ns() {
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (long long)ts.tv_sec * 1000000000LL + ts.tv_nsec;
+}
+
+/* Returns the current monotonic time in seconds */
+static inline double now_seconds() {
+    return now_ns() / 1e9;
+}
+
+/* Returns the context switches, voluntary plus involuntary, of every reaped child so far */
+static inline long child_switches() {
+    struct rusage usage;
+    getrusage(RUSAGE_CHILDREN, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+#endif
@@ -0,0 +1,101 @@
+/* Micro-benchmark comparing fork, posix_spawn and zygote launch latency.
+
+Runs pipelines of 1, 8 and 64 stages of /usr/bin/true through run_job in
+each launch mode and prints one CSV row per combination. An optional
+argument gives megabytes of touched memory to hold while measuring, which
+shows how fork cost grows with the size of the shell. The zygote is started
+before the ballast is touched, as mysh starts it before the shell grows.
+Before measuring a mode, the benchmark moves to a new directory and checks
+that the mode starts programs there, as it must after cd.
+
+usage: launchbench [ballast_mb] [iterations]
+*/
+#include "../jobs.h"
+#include "../runjob.h"
+#include "../launch.h"
+#include "../jobtable.h"
+#include "benchutil.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+
+#define MOST_STAGES 64
+
+static const int stageCounts[] = {1, 8, MOST_STAGES};
+static struct Command benchCommands[MOST_STAGES];
+static struct Job benchJob;
+
+/* Fills the benchmark job with the given number of stages running argv */
+static void build_job(int stages, char **argv, int argc) {
+    memset(&benchJob, 0, sizeof(benchJob));
+    for (int i = 0; i < stages; i++) {
+        benchCommands[i].argv = argv;
+        benchCommands[i].argc = argc;
+    }
+    benchJob.pipeline = benchCommands;
+    benchJob.num_stages = stages;
+}
+
+int main(int argc, char *argv[]) {
+    int ballastMb = argc > 1 ? atoi(argv[1]) : 0;
+    int iterations = argc > 2 ? atoi(argv[2]) : 200;
+    static char *trueArgv[] = {"/usr/bin/true", NULL};
+    static char *markerArgv[] = {"/usr/bin/test", "-f", "launchbench-marker", NULL};
+    const char *modeNames[] = {"fork", "spawn", "zygote"};
+    int modes[] = {LAUNCH_FORK, LAUNCH_SPAWN, LAUNCH_ZYGOTE};
+    char directory[] = "/tmp/launchbench-XXXXXX";
+
+    // selecting the zygote once starts it, it keeps running while other modes are measured
+    set_launch_mode(LAUNCH_ZYGOTE);
+
+    // Touch every page so fork has real page tables to copy
+    if (ballastMb > 0) {
+        char *ballast = malloc((size_t)ballastMb << 20);
+        memset(ballast, 1, (size_t)ballastMb << 20);
+    }
+
+    jobs_init(0);
+
+    // the zygote was forked elsewhere, so its programs only start here if it follows the shell
+    if (mkdtemp(directory) == NULL || chdir(directory) != 0) {
+        fprintf(stderr, "launchbench: cannot make a directory to check launches in\n");
+        return 1;
+    }
+    close(open("launchbench-marker", O_WRONLY | O_CREAT | O_CLOEXEC, 0600));
+
+    printf("mode,stages,ballast_mb,iterations,usec_per_job,usec_per_stage\n");
+    for (int m = 0; m < 3; m++) {
+        set_launch_mode(modes[m]);
+        if (get_launch_mode() != modes[m]) {
+            fprintf(stderr, "launchbench: %s mode is not available\n", modeNames[m]);
+            continue;
+        }
+        build_job(1, markerArgv, 3);
+        run_job(&benchJob);
+        if (last_exit_status() != 0) {
+            fprintf(stderr, "launchbench: %s mode does not start programs in the current directory\n", modeNames[m]);
+            continue;
+        }
+        for (int s = 0; s < 3; s++) {
+            int stages = stageCounts[s];
+            // keep the total number of processes per row roughly constant
+            int runs = iterations * 8 / stages;
+            if (runs < 4) runs = 4;
+
+            build_job(stages, trueArgv, 1);
+            long long start = now_ns();
+            for (int r = 0; r < runs; r++) {
+                run_job(&benchJob);
+            }
+            double perJob = (now_ns() - start) / 1000.0 / runs;
+            printf("%s,%d,%d,%d,%.1f,%.2f\n", modeNames[m], stages, ballastMb, runs,
+                   perJob, perJob / stages);
+        }
+    }
+    unlink("launchbench-marker");
+    chdir("/");
+    rmdir(directory);
+    return 0;
+}
@@ -0,0 +1,375 @@
+/* Parser micro-benchmark.
+
+Parses a corpus of realistic command lines repeatedly with parse_job and
+with a copy of the three pass parser it replaced (tokenize_line,
+process_commands, process_job), then prints lines per second for each as CSV,
+along with the most job heap one line needed and the most the heap had mapped.
+
+usage: parsebench [seconds_per_parser]
+*/
+#include "../jobs.h"
+#include "../parsejob.h"
+#include "../myheap.h"
+#include "../mystring.h"
+#include "benchutil.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+
+const char *legacyMalformed = "Error while processing command: malformed input\n";
+const char *legacyHeapError = "Error while processing command: out of memory for command\n";
+const char *legacyExit = "exit";
+
+/* The old Job held one input and one output file, which the copy still fills in here */
+static char *legacyInfile;
+static char *legacyOutfile;
+
+/* Lines are valid for both parsers: redirections after every | and no quoting */
+static const char *corpus[] = {
+    "ls -la /usr/bin\n",
+    "grep -rn TODO src include | sort | uniq -c | sort -rn | head -20 > todo.txt\n",
+    "cat access.log | cut -d ' ' -f 1 | sort | uniq -c | sort -rn\n",
+    "find . -name *.c -newer Makefile\n",
+    "gzip -dc data.csv.gz | awk -F, {print} | gzip -9 > out.csv.gz &\n",
+    "make -j8 CFLAGS=-O2 all\n",
+    "tar -cf - dir | xz -T0 -c > dir.tar.xz\n",
+    "sort -k2,2n -t, < input.csv > sorted.csv\n",
+    "wc -l\n",
+    "xargs -n 1 -P 8 convert -resize 50% < images.txt\n",
+};
+
+#define CORPUS_SIZE (sizeof(corpus) / sizeof(corpus[0]))
+
+/* Sizes found by tokenize_line, used to size the job */
+struct TokenCounts
+{
+  unsigned int tokens;
+  unsigned int commands;
+};
+
+/* Checks if a given symbol is whitespace, null, or a terminal symbol
+
+n - the symbol to be checked
+
+Returns:
+    0 if the symbol is space, tab, or null (' ', '\t', '\0')
+    1 if the symbol is |
+    2 if the symbol is <
+    3 if the symbol is >
+    4 if the symbol is &
+    5 if the symbol is new line ('\n')
+    -1 if the symbol is anything else 
+*/
+static int legacy_check_for(char n) {
+    if (n == ' ' || n == '\t' || n == '\0') return 0;
+    if (n == '|') return 1;
+    if (n == '<') return 2;
+    if (n == '>') return 3;
+    if (n == '&') return 4;
+    if (n == '\n') return 5;
+    return -1;
+}
+
+/* Populates the commands of the supplied job structure until one of < > & or \n are encountered
+
+job - the job structure to be populated, with room for every command in job->pipeline
+heapStart - the start of the tokens written by tokenize_line
+args - room for a pointer to every token plus a NULL per command,
+    carved up into the argv arrays of the commands in order
+
+Returns:
+    a positive value if run successful, equal to the position of the first 
+        terminal symbol encountered, relative to heapStart
+    -50 if an exit command is detected
+*/
+static int legacy_process_commands(struct Job* job, char* heapStart, char** args) {
+    int numArgs = 0;
+    unsigned int numCommands = 0;
+    int newToken = 0;
+    int i = 0;
+    // Check for exit command
+    if (mystrcmp(heapStart, legacyExit) == 0) {
+        return -50;
+    }
+    // Continue until first < or > or & or end of file
+    while (legacy_check_for(heapStart[i]) < 2) {
+        job->pipeline[numCommands].argv = args;
+        // Continue until | (i.e. end of command)
+        while (legacy_check_for(heapStart[i]) < 1) {
+            // Continue until null (i.e. end of token)
+            while (legacy_check_for(heapStart[i]) < 0) {
+                if (newToken == 0) {
+                    // Set command argument
+                    *args = &heapStart[i];
+                    args += 1;
+                    newToken = 1;
+                }
+                i += 1;
+            }
+            // Set up for next token to be added
+            newToken = 0;
+            numArgs += 1;
+			
+			// Move i forward if it's not < > & \n
+            if (legacy_check_for(heapStart[i]) < 2) {
+                i += 1;
+            }
+        }
+        // Set argc of pipeline, terminate argv and set up for next command
+        job->pipeline[numCommands].argc = numArgs;
+        *args = NULL;
+        args += 1;
+        newToken = 0;
+        numArgs = 0;
+        numCommands += 1;
+
+		// Move i forward if it's not < > & \n
+        if (legacy_check_for(heapStart[i]) < 2) {
+            i += 1;
+        }
+    }
+    job->num_stages = numCommands;
+    return i;
+}
+
+/* Populates the supplied job structure by reading the tokens from the heap.
+First, populates the command structures via process_commands,
+then populates any other relevant fields itself.
+
+job - the job structure to be populated
+tokens - the start of the tokens written by tokenize_line
+counts - the number of tokens and commands tokenize_line found,
+    used to size the command and argument arrays taken from the heap
+
+Returns:
+    1 if an exit command is detected
+    0 if run successful
+    -4 if a malformed command is detected
+    -5 if the heap could not hold the job
+*/
+static int legacy_process_job(struct Job* job, char* tokens, struct TokenCounts* counts) {
+    char *heapPos = tokens;
+    char **args;
+    int status;
+    int setIn = 0;
+    int setOut = 0;
+    int setBack = 0;
+
+    // Set default values first
+    legacyInfile = NULL;
+    legacyOutfile = NULL;
+    job->background = 0;
+
+    // Size the job to this line: one Command per stage, one pointer per token plus a NULL per stage
+    job->pipeline = (struct Command *)alloc(sizeof(struct Command) * counts->commands);
+    args = (char **)alloc(sizeof(char *) * (counts->tokens + counts->commands));
+    if (job->pipeline == NULL || args == NULL) {
+        write(1, legacyHeapError, 58);
+        return -5;
+    }
+    
+    status = legacy_process_commands(job, tokens, args);
+    if (status == -50) {
+        return 1;
+    } else if (status < 0) {
+        return status;
+    } else {
+        heapPos += status;
+    }
+    while (legacy_check_for(*heapPos) < 5) {
+        switch (legacy_check_for(*heapPos)) {
+            // No more | should occur after the first < > &
+            case 1:
+				write(1, legacyMalformed, 48);
+                return -4;
+                break;
+            // infile <
+            // each field should only have one token each maximum
+            case 2:
+                if (setIn == 0) {
+                    legacyInfile = heapPos + 1;
+                    setIn = 1;
+                } else {
+					write(1, legacyMalformed, 48);
+                    return -4;
+                }
+                break;
+            // outfile >
+            case 3:
+                if (setOut == 0) {
+                    legacyOutfile = heapPos + 1;
+                    setOut = 1;
+                } else {
+					write(1, legacyMalformed, 48);
+                    return -4;
+                }
+                break;
+            // background &
+            case 4:
+                if (setBack == 0) {
+                    job->background = 1;
+                    setBack = 1;
+                } else {
+					write(1, legacyMalformed, 48);
+                    return -4;
+                }
+                break;
+            }
+        heapPos += 1;
+    }
+    return 0;
+}
+
+/* Tokenizes the contents of the supplied buffer onto the heap,
+removing excess whitespace and null terminating each token. Space for the worst case is taken
+from the heap up front, so the tokens are contiguous
+
+buffer - the beginning of the buffer to be tokenized
+length - the number of characters in the buffer
+tokens - set to the start of the tokens on the heap
+counts - set to the number of tokens and commands written
+
+Returns:
+    0 if run successful
+    -4 if a malformed command is detected
+    -5 if the heap could not hold the tokens
+
+*/
+static int legacy_tokenize_line(char* buffer, int length, char** tokens, struct TokenCounts* counts) {
+    int i = 0;
+    int newToken = 0;
+    int startOfCommand = 0;
+    int pos = 0;
+    // each character writes at most itself and a null
+    char* n = alloc((unsigned long)length * 2 + 2);
+
+    if (n == NULL) {
+        write(1, legacyHeapError, 58);
+        return -5;
+    }
+    *tokens = n;
+    counts->tokens = 0;
+    counts->commands = 0;
+    while (legacy_check_for(buffer[i]) < 5) {
+        // Non-whitespace, non-terminal characters written to heap normally
+        if ((legacy_check_for(buffer[i]) < 0)) {
+            // Mark the start of a new token if previous characters were special cases
+            if (newToken < 1) {
+                newToken = 1;
+                // If this is the first argument of a command, count a new command
+                if (startOfCommand == 0) {
+                    counts->commands += 1;
+                    startOfCommand = 1;
+                }
+            }
+            n[pos++] = buffer[i];
+        }
+        else if (legacy_check_for(buffer[i]) > -1) {
+            if (newToken == 1) {
+                // null terminate the token
+                n[pos++] = '\0';
+                counts->tokens += 1;
+                newToken = 0;
+            }
+            
+            if (legacy_check_for(buffer[i]) > 0) {
+                // If a terminal character has been reached without any token having
+                 // been recorded (e.g. ||), the command is malformed
+                if (startOfCommand == 0) {
+					write(1, legacyMalformed, 48);
+                    return -4;
+                } else {
+                    // If the symbol is | then this is a new command
+                    if (legacy_check_for(buffer[i]) == 1) {
+                        startOfCommand = 0;
+                    }
+                    // If the symbol is terminal, add it to the heap for later processing
+                    if (legacy_check_for(buffer[i]) > 0) {
+                        n[pos++] = buffer[i];
+                    }
+                }
+            }
+        }
+        i += 1;
+    }
+
+    // if there is not a final token and the command doesn't
+    // end with &, the command is malformed
+    if (newToken == 1) {
+        // null terminate the final token if present
+        n[pos++] = '\0';
+        counts->tokens += 1;
+        newToken = 0;
+    } else if (pos > 0) {
+        if (legacy_check_for(n[pos - 1]) != 0 && legacy_check_for(n[pos - 1]) != 4) {
+			write(1, legacyMalformed, 48);
+            return -4;
+        }
+    }
+    // add a newline to the heap so final processing knows when to stop 
+    n[pos] = '\n';
+    return 0;
+}
+
+
+
+/* Parses one line the way get_job did before parse_job existed */
+static int legacy_parse(char *line, struct Job *job) {
+    char *tokens;
+    struct TokenCounts counts;
+    int status = legacy_tokenize_line(line, strlen(line), &tokens, &counts);
+
+    if (status < 0) {
+        return status;
+    }
+    return legacy_process_job(job, tokens, &counts);
+}
+
+int main(int argc, char *argv[]) {
+    double seconds = argc > 1 ? atof(argv[1]) : 1.0;
+    static char lines[CORPUS_SIZE][256];
+    unsigned int lengths[CORPUS_SIZE];
+    const char *names[] = {"three_pass", "single_pass"};
+    struct Job job;
+    struct HeapStats stats;
+
+    for (unsigned int i = 0; i < CORPUS_SIZE; i++) {
+        strcpy(lines[i], corpus[i]);
+        lengths[i] = strlen(corpus[i]);
+    }
+
+    printf("parser,lines,seconds,lines_per_sec,heap_high_water,heap_peak_mapped\n");
+    for (int p = 0; p < 2; p++) {
+        // each parser gets a fresh heap, so the figures are its own
+        struct Arena heap = {0};
+        unsigned long count = 0;
+        double start = now_seconds();
+        double elapsed;
+
+        swap_job_heap(&heap);
+
+        do {
+            // check the clock every corpus pass
+            for (unsigned int i = 0; i < CORPUS_SIZE; i++) {
+                free_all();
+                memset(&job, 0, sizeof(job));
+                if (p == 0) {
+                    legacy_parse(lines[i], &job);
+                } else {
+                    // parse_job writes into its own heap copy, the line is untouched
+                    parse_job(lines[i], lengths[i], &job);
+                }
+            }
+            count += CORPUS_SIZE;
+            elapsed = now_seconds() - start;
+        } while (elapsed < seconds);
+
+        heap_stats(&stats);
+        swap_job_heap(NULL);
+        arena_release(&heap);
+        printf("%s,%lu,%.2f,%.0f,%lu,%lu\n", names[p], count, elapsed, count / elapsed,
+               stats.high_water, stats.peak_mapped);
+    }
+    return 0;
+}
@@ -0,0 +1,61 @@
+/* Benchmark of pipeline throughput at different pipe capacities.
+
+Runs "dd if=/dev/zero bs=16k | /bin/cat | /bin/cat > /dev/null" through
+run_job once for each pipe size and prints one CSV row per size with the
+throughput and the context switches of the stages. Small pipes make the
+stages block and wake each other far more often.
+
+usage: pipebench [megabytes]
+*/
+#include "../jobs.h"
+#include "../runjob.h"
+#include "../jobtable.h"
+#include "../pipesize.h"
+#include "benchutil.h"
+#include <stdio.h>
+#include <stdlib.h>
+
+#define BENCH_STAGES 3
+
+static const long pipeSizes[] = {4096, 16384, 65536, 262144, 1048576};
+
+/* Times one run of the pipeline at the given pipe size and prints its row */
+static void run_size(struct Job *job, long size, int megabytes) {
+    long before = child_switches();
+    long long start = now_ns();
+
+    set_pipe_size(size);
+    run_job(job);
+    double seconds = (now_ns() - start) / 1e9;
+    long switches = child_switches() - before;
+    printf("%ld,%d,%.3f,%.1f,%ld,%.1f\n", effective_pipe_size(), megabytes, seconds,
+           megabytes / seconds, switches, switches / (double)megabytes);
+}
+
+int main(int argc, char *argv[]) {
+    int megabytes = argc > 1 ? atoi(argv[1]) : 1024;
+    char count[32];
+    char *ddArgv[] = {"dd", "if=/dev/zero", "bs=16k", count, "status=none", NULL};
+    char *catArgv[] = {"/bin/cat", NULL};
+    struct Redirection output = {.type = REDIRECT_OUTPUT, .fd = 1, .word = "/dev/null", .source = -1};
+    struct Command commands[BENCH_STAGES] = {
+        {.argv = ddArgv, .argc = 5},
+        {.argv = catArgv, .argc = 1},
+        {.argv = catArgv, .argc = 1, .redirections = &output, .num_redirections = 1},
+    };
+    struct Job job = {.pipeline = commands, .num_stages = BENCH_STAGES};
+
+    snprintf(count, sizeof(count), "count=%d", megabytes * 64);
+    jobs_init(0);
+
+    printf("pipe_bytes,megabytes,seconds,mb_per_sec,context_switches,switches_per_mb\n");
+    for (unsigned int i = 0; i < sizeof(pipeSizes) / sizeof(pipeSizes[0]); i++) {
+        if (pipeSizes[i] <= pipe_max_size()) {
+            run_size(&job, pipeSizes[i], megabytes);
+        }
+    }
+    if (pipe_max_size() > pipeSizes[sizeof(pipeSizes) / sizeof(pipeSizes[0]) - 1]) {
+        run_size(&job, pipe_max_size(), megabytes);
+    }
+    return 0;
+}
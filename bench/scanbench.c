@@ -0,0 +1,86 @@
+/* Delimiter scanner benchmark.
+
+Builds generated command lines of 4 KB to 1 MB (an xargs style command
+followed by many path arguments) and measures, for each scanner the cpu
+supports, the throughput of splitting the line at every special byte
+and of a full parse_job of the line. Prints CSV.
+
+usage: scanbench [seconds_per_row]
+*/
+#include "../jobs.h"
+#include "../parsejob.h"
+#include "../scan.h"
+#include "../myheap.h"
+#include "benchutil.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+static const unsigned int lineSizes[] = {4096, 65536, 1048576};
+
+/* Fills a buffer with "cmd -v path path ... \n" using paths of varying length */
+static unsigned int build_line(char *line, unsigned int size) {
+    unsigned int pos = 0;
+    unsigned int n = 0;
+
+    pos += sprintf(line, "process-files -v");
+    while (pos < size - 80) {
+        pos += sprintf(line + pos, " /var/log/app/shard-%03u/events-2025-%02u-%02u.jsonl",
+                       n % 1000, n % 12 + 1, n % 28 + 1);
+        n += 1;
+    }
+    line[pos++] = '\n';
+    return pos;
+}
+
+/* Splits a line at every special byte, as the lexer would */
+static unsigned long split_line(const char *line, unsigned int length) {
+    const char *p = line;
+    const char *end = line + length;
+    unsigned long words = 0;
+
+    while (p < end) {
+        p = scan_word_end(p, end) + 1;
+        words += 1;
+    }
+    return words;
+}
+
+int main(int argc, char *argv[]) {
+    double seconds = argc > 1 ? atof(argv[1]) : 0.5;
+    const char *names[] = {"scalar", "sse2", "avx2"};
+    char *line = malloc(lineSizes[2]);
+    volatile unsigned long sink = 0;
+    struct Job job;
+
+    printf("scanner,operation,line_bytes,mb_per_sec\n");
+    for (int s = 0; s < 3; s++) {
+        unsigned int length = build_line(line, lineSizes[s]);
+
+        for (int kind = SCAN_SCALAR; kind <= SCAN_AVX2; kind++) {
+            if (scan_use(kind) != 0) {
+                continue;
+            }
+            for (int op = 0; op < 2; op++) {
+                unsigned long bytes = 0;
+                double start = now_seconds();
+                double elapsed;
+
+                do {
+                    if (op == 0) {
+                        sink += split_line(line, length);
+                    } else {
+                        free_all();
+                        parse_job(line, length, &job);
+                    }
+                    bytes += length;
+                    elapsed = now_seconds() - start;
+                } while (elapsed < seconds);
+
+                printf("%s,%s,%u,%.1f\n", names[kind], op == 0 ? "split" : "parse_job", length,
+                       bytes / elapsed / 1e6);
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,890 @@
+#include "builtins.h"
+#include "pathcache.h"
+#include "jobtable.h"
+#include "parallel.h"
+#include "getjob.h"
+#include "datamove.h"
+#include "pipesize.h"
+#include "mystring.h"
+#include "env.h"
+#include "history.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <limits.h>
+#include <sys/stat.h>
+
+const char *hashUsageError = "usage: hash [-r] [name ...]\n";
+const char *hashNotFoundError = "hash: command not found\n";
+const char *hashEmptyMessage = "hash: hash table empty\n";
+const char *noJobError = ": no such job\n";
+const char *noJobControlError = ": no job control\n";
+const char *parallelUsageError = "usage: parallel [-j jobs] [file]\n";
+const char *parallelOpenError = "parallel: cannot open job file\n";
+const char *openFileError = ": cannot open file\n";
+const char *copyError = ": error while copying\n";
+const char *pipesizeUsageError = "usage: pipesize [bytes[k|m] | auto | default]\n";
+const char *cdUsageError = "usage: cd [dir | -]\n";
+const char *cdError = ": cannot change directory\n";
+const char *notSetError = " not set\n";
+const char *pwdError = "pwd: cannot read current directory\n";
+const char *identifierError = ": not a valid identifier\n";
+const char *storeError = ": out of memory for variable\n";
+const char *numericError = ": numeric argument required\n";
+const char *tooManyError = ": too many arguments\n";
+const char *bracketError = "[: missing ]\n";
+const char *operatorError = ": unknown operator\n";
+const char *integerError = ": integer expression expected\n";
+const char *historyUsageError = "usage: history [prefix]\n";
+
+#define BUILTIN_MOVES_DATA 1     /* only copies between its input, output and files */
+#define BUILTIN_NO_STATE   2     /* only reads its arguments and writes its output */
+
+#define BUILTIN_TABLE_SIZE 64    /* slots in the name lookup table, a power of two well above the number of builtins */
+#define ECHO_BUFFER_SIZE 4096    /* bytes echo gathers before each write */
+
+/* A builtin command and the function implementing it */
+struct Builtin
+{
+  const char *name;
+  builtin_function function;
+  int flags;                /* 0, BUILTIN_MOVES_DATA or BUILTIN_NO_STATE */
+};
+
+
+/* Implements hash: with no arguments lists the remembered command locations,
+-r forgets them, and any names given are looked up and remembered
+
+Arguments are those of builtin_function
+
+Returns:
+    0 if successful
+    1 if a name was not found
+    2 if the arguments were invalid
+*/
+static int builtin_hash(int argc, char *argv[], int in, int out) {
+    int status = 0;
+
+    if (argc == 1) {
+        if (print_command_cache(out) == 0) {
+            write(out, hashEmptyMessage, 23);
+        }
+        return 0;
+    }
+    for (int i = 1; i < argc; i++) {
+        if (mystrcmp(argv[i], "-r") == 0) {
+            clear_command_cache();
+        } else if (argv[i][0] == '-') {
+            write(1, hashUsageError, 28);
+            return 2;
+        } else if (find_command(argv[i]) == NULL) {
+            write(1, hashNotFoundError, 24);
+            status = 1;
+        }
+    }
+    return status;
+}
+
+/* Writes "name: message" for a failing builtin
+
+name - the builtin's name (argv[0]), or the argument the message is about
+message - the text after the name, starting with ": "
+
+Returns:
+    1, the usual exit status of a failed builtin
+*/
+static int builtin_error(const char *name, const char *message) {
+    write(1, name, mystrlen(name));
+    write(1, message, mystrlen(message));
+    return 1;
+}
+
+/* Implements jobs: lists running and stopped jobs
+
+Arguments are those of builtin_function
+
+Returns:
+    0
+*/
+static int builtin_jobs(int argc, char *argv[], int in, int out) {
+    handle_job_events();
+    print_jobs(out);
+    return 0;
+}
+
+/* Implements fg [%n]: continues a job with the terminal and waits for it
+
+Arguments are those of builtin_function
+
+Returns:
+    the exit status of the job, 128 plus the signal if it stopped again
+    1 if there is no such job or no job control
+*/
+static int builtin_fg(int argc, char *argv[], int in, int out) {
+    struct JobEntry *entry;
+
+    if (!job_control_enabled()) {
+        return builtin_error(argv[0], noJobControlError);
+    }
+    entry = find_job(argc > 1 ? argv[1] : NULL);
+    if (entry == NULL) {
+        return builtin_error(argv[0], noJobError);
+    }
+    write(out, entry->command, mystrlen(entry->command));
+    write(out, "\n", 1);
+    continue_job(entry, 1);
+    return wait_for_job(entry);
+}
+
+/* Implements bg [%n]: continues a stopped job in the background
+
+Arguments are those of builtin_function
+
+Returns:
+    0 if successful
+    1 if there is no such job or no job control
+*/
+static int builtin_bg(int argc, char *argv[], int in, int out) {
+    struct JobEntry *entry;
+    char number[20];
+
+    if (!job_control_enabled()) {
+        return builtin_error(argv[0], noJobControlError);
+    }
+    entry = find_job(argc > 1 ? argv[1] : NULL);
+    if (entry == NULL) {
+        return builtin_error(argv[0], noJobError);
+    }
+    continue_job(entry, 0);
+    write(out, "[", 1);
+    write(out, number, myitoa(entry->id, number));
+    write(out, "] ", 2);
+    write(out, entry->command, mystrlen(entry->command));
+    write(out, "\n", 1);
+    return 0;
+}
+
+/* Implements wait [%n ...]: with no arguments waits for every background
+job, otherwise for each job given in turn
+
+Arguments are those of builtin_function
+
+Returns:
+    0 if waiting for every job
+    the exit status of the last job given
+    127 if the last job given does not exist (finished jobs leave the table once reaped)
+*/
+static int builtin_wait(int argc, char *argv[], int in, int out) {
+    struct JobEntry *entry;
+    int status = 0;
+
+    if (argc == 1) {
+        return wait_for_background() == 0 ? 0 : 1;
+    }
+    for (int i = 1; i < argc; i++) {
+        entry = find_job(argv[i]);
+        if (entry == NULL) {
+            builtin_error(argv[i], noJobError);
+            status = EXIT_NOT_EXECUTED;
+            continue;
+        }
+        // waited for here, so not reported and freed when it finishes
+        entry->background = 0;
+        status = wait_for_job(entry);
+    }
+    return status;
+}
+
+/* Implements parallel [-j N] [file]: runs each line of the file, or of the
+builtin's input, as a job with at most N running at once (default: one per
+online cpu). Lines on the shell's own input are taken from its reader, so
+the lines after parallel in a script or pipe are its jobs
+
+Arguments are those of builtin_function
+
+Returns:
+    0 if every job succeeded
+    1 if a job failed or the file could not be opened
+    2 if the arguments were invalid
+*/
+static int builtin_parallel(int argc, char *argv[], int in, int out) {
+    struct LineReader fileReader;
+    struct LineReader *reader = &fileReader;
+    struct LineReader *shellReader = job_input_reader();
+    void (*shellHandler)() = shellReader->event_handler;
+    long limit = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *path = NULL;
+    int fd = in;
+    int status;
+
+    for (int i = 1; i < argc; i++) {
+        if (argv[i][0] == '-' && argv[i][1] == 'j') {
+            // both -j N and -jN
+            const char *count = argv[i][2] != '\0' ? argv[i] + 2 : argv[++i];
+            if (count == NULL || myatoi(count, &limit) != 0 || limit < 1) {
+                write(1, parallelUsageError, 33);
+                return 2;
+            }
+        } else if (argv[i][0] != '-' && path == NULL) {
+            path = argv[i];
+        } else {
+            write(1, parallelUsageError, 33);
+            return 2;
+        }
+    }
+    // every running job holds a job table entry
+    if (limit < 1) {
+        limit = 1;
+    } else if (limit > JOB_TABLE_SIZE) {
+        limit = JOB_TABLE_SIZE;
+    }
+
+    if (path != NULL) {
+        fd = open(path, O_RDONLY | O_CLOEXEC);
+        if (fd == -1) {
+            write(1, parallelOpenError, 31);
+            return 1;
+        }
+    }
+
+    if (path == NULL && fd == shellReader->fd) {
+        // the reader may already hold the job lines, and must not redraw the prompt
+        reader = shellReader;
+        reader_set_event(reader, reader->event_fd, NULL);
+        status = run_parallel(reader, limit, out, fd == 0);
+        reader_set_event(reader, reader->event_fd, shellHandler);
+        // a terminal can be read again after ^D
+        if (isatty(fd)) {
+            reader->eof = 0;
+        }
+        return status;
+    }
+
+    reader_init(reader, fd);
+    status = run_parallel(reader, limit, out, fd == 0);
+    reader_release(reader);
+    if (path != NULL) {
+        close(fd);
+    }
+    return status;
+}
+
+/* Turns the result of move_data or tee_data into an exit status, reporting errors
+
+name - the builtin's name (argv[0])
+result - the value returned by the copy
+
+Returns:
+    0 if the copy succeeded
+    128 plus SIGPIPE if the reader went away, as a killed program would report
+    128 plus SIGINT if Ctrl-C ended the copy
+    1 for any other error
+*/
+static int copy_status(const char *name, int result) {
+    if (result == 0) {
+        return 0;
+    }
+    if (errno == EPIPE) {
+        return 128 + SIGPIPE;
+    }
+    if (errno == EINTR) {
+        return 128 + SIGINT;
+    }
+    builtin_error(name, copyError);
+    return 1;
+}
+
+/* Implements cat [file ...]: copies each file, or the input if there are
+none or the name is -, to the output inside the kernel where possible
+
+Arguments are those of builtin_function
+
+Returns:
+    0 if successful
+    1 if a file could not be opened or copied
+    128 plus the signal number if the copy was cut short
+*/
+static int builtin_cat(int argc, char *argv[], int in, int out) {
+    int status = 0;
+    int fd;
+
+    if (argc == 1) {
+        return copy_status(argv[0], move_data(in, out));
+    }
+    for (int i = 1; i < argc; i++) {
+        if (mystrcmp(argv[i], "-") == 0) {
+            fd = in;
+        } else {
+            fd = open(argv[i], O_RDONLY | O_CLOEXEC);
+            if (fd == -1) {
+                status = builtin_error(argv[i], openFileError);
+                continue;
+            }
+        }
+        int result = copy_status(argv[0], move_data(fd, out));
+        if (fd != in) {
+            close(fd);
+        }
+        if (result > 1) {
+            return result;
+        }
+        if (result != 0) {
+            status = result;
+        }
+    }
+    return status;
+}
+
+/* Implements tee [-a] [file ...]: copies the input to the output and to
+every file, truncating the files unless -a is given
+
+Arguments are those of builtin_function
+
+Returns:
+    0 if successful
+    1 if a file could not be opened or the copy failed
+    128 plus the signal number if the copy was cut short
+*/
+static int builtin_tee(int argc, char *argv[], int in, int out) {
+    int files[argc];
+    int count = 0;
+    int flags = O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC;
+    int first = 1;
+    int status = 0;
+    int result;
+
+    if (argc > 1 && mystrcmp(argv[1], "-a") == 0) {
+        flags = O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC;
+        first = 2;
+    }
+    for (int i = first; i < argc; i++) {
+        files[count] = open(argv[i], flags, S_IRUSR | S_IWUSR);
+        if (files[count] == -1) {
+            status = builtin_error(argv[i], openFileError);
+            continue;
+        }
+        count += 1;
+    }
+
+    result = copy_status(argv[0], tee_data(in, out, files, count));
+    for (int i = 0; i < count; i++) {
+        close(files[i]);
+    }
+    return result != 0 ? result : status;
+}
+
+/* Implements pipesize [N|auto|default]: with no argument shows the capacity
+given to new pipeline pipes, otherwise sets it. N may end in k or m
+
+Arguments are those of builtin_function
+
+Returns:
+    0 if successful
+    2 if the arguments were invalid
+*/
+static int builtin_pipesize(int argc, char *argv[], int in, int out) {
+    char number[20];
+    long size;
+
+    if (argc == 1) {
+        size = get_pipe_size();
+        if (size == PIPE_SIZE_DEFAULT) {
+            write(out, "default", 7);
+        } else {
+            if (size == PIPE_SIZE_AUTO) {
+                write(out, "auto ", 5);
+            }
+            write(out, number, myitoa(effective_pipe_size(), number));
+        }
+        write(out, " (max ", 6);
+        write(out, number, myitoa(pipe_max_size(), number));
+        write(out, ")\n", 2);
+        return 0;
+    }
+    if (argc > 2 || parse_pipe_size(argv[1], &size) != 0) {
+        write(1, pipesizeUsageError, 46);
+        return 2;
+    }
+    set_pipe_size(size);
+    return 0;
+}
+
+/* Implements cd [dir | -]: changes the shell's directory to dir, $HOME
+with no argument, or $OLDPWD for -, and updates $PWD and $OLDPWD
+
+Arguments are those of builtin_function
+
+Returns:
+    0 if successful
+    1 if the directory could not be entered or the variable is not set
+    2 if the arguments were invalid
+*/
+static int builtin_cd(int argc, char *argv[], int in, int out) {
+    char previous[PATH_MAX];
+    const char *dir;
+
+    if (argc > 2) {
+        write(1, cdUsageError, 20);
+        return 2;
+    }
+    if (argc == 1) {
+        dir = env_get("HOME");
+        if (dir == NULL) {
+            return builtin_error("cd: HOME", notSetError);
+        }
+    } else if (mystrcmp(argv[1], "-") == 0) {
+        dir = env_get("OLDPWD");
+        if (dir == NULL) {
+            return builtin_error("cd: OLDPWD", notSetError);
+        }
+    } else {
+        dir = argv[1];
+    }
+
+    if (getcwd(previous, sizeof(previous)) == NULL) {
+        previous[0] = '\0';
+    }
+    if (chdir(dir) == -1) {
+        return builtin_error(dir, cdError);
+    }
+    if (previous[0] != '\0') {
+        env_set("OLDPWD", previous, 0);
+    }
+    if (getcwd(previous, sizeof(previous)) != NULL) {
+        env_set("PWD", previous, 0);
+        // like other shells, cd - shows where it went
+        if (argc == 2 && mystrcmp(argv[1], "-") == 0) {
+            write(out, previous, mystrlen(previous));
+            write(out, "\n", 1);
+        }
+    }
+    return 0;
+}
+
+/* Implements pwd: writes the shell's current directory
+
+Arguments are those of builtin_function
+
+Returns:
+    0 if successful
+    1 if the directory could not be read
+*/
+static int builtin_pwd(int argc, char *argv[], int in, int out) {
+    char dir[PATH_MAX];
+    int length;
+
+    if (getcwd(dir, sizeof(dir)) == NULL) {
+        write(1, pwdError, 35);
+        return 1;
+    }
+    length = mystrlen(dir);
+    dir[length] = '\n';
+    write(out, dir, length + 1);
+    return 0;
+}
+
+/* Implements echo [-n] [word ...]: writes the words separated by spaces and
+followed by a newline unless -n is given, in as few writes as possible
+
+Arguments are those of builtin_function
+
+Returns:
+    0 if successful
+    1 if the output could not be written
+*/
+static int builtin_echo(int argc, char *argv[], int in, int out) {
+    char buffer[ECHO_BUFFER_SIZE];
+    int newline = 1;
+    int first = 1;
+    int pos = 0;
+
+    if (argc > 1 && mystrcmp(argv[1], "-n") == 0) {
+        newline = 0;
+        first = 2;
+    }
+    for (int i = first; i < argc; i++) {
+        for (const char *c = argv[i]; ; c++) {
+            if (pos == ECHO_BUFFER_SIZE) {
+                if (write(out, buffer, pos) == -1) {
+                    return 1;
+                }
+                pos = 0;
+            }
+            if (*c == '\0') {
+                break;
+            }
+            buffer[pos++] = *c;
+        }
+        if (i < argc - 1) {
+            buffer[pos++] = ' ';
+        }
+    }
+    if (newline) {
+        buffer[pos++] = '\n';
+    }
+    if (pos > 0 && write(out, buffer, pos) == -1) {
+        return 1;
+    }
+    return 0;
+}
+
+/* Implements true: does nothing, successfully
+
+Arguments are those of builtin_function
+
+Returns:
+    0
+*/
+static int builtin_true(int argc, char *argv[], int in, int out) {
+    return 0;
+}
+
+/* Implements false: does nothing, unsuccessfully
+
+Arguments are those of builtin_function
+
+Returns:
+    1
+*/
+static int builtin_false(int argc, char *argv[], int in, int out) {
+    return 1;
+}
+
+/* Implements export [name[=value] ...]: marks each variable exported,
+setting the ones given a value, or with no arguments lists the exported
+variables as export lines
+
+Arguments are those of builtin_function
+
+Returns:
+    0 if successful
+    1 if a name was not valid or the variable could not be stored
+*/
+static int builtin_export(int argc, char *argv[], int in, int out) {
+    int status = 0;
+
+    if (argc == 1) {
+        print_exports(out);
+        return 0;
+    }
+    for (int i = 1; i < argc; i++) {
+        int length = 0;
+        int result;
+
+        while (argv[i][length] != '\0' && argv[i][length] != '=') {
+            length += 1;
+        }
+        if (!env_valid_name(argv[i], length)) {
+            status = builtin_error(argv[i], identifierError);
+            continue;
+        }
+        result = argv[i][length] == '=' ? env_assign(argv[i], 1) : env_export(argv[i]);
+        if (result != 0) {
+            status = builtin_error(argv[i], storeError);
+        }
+    }
+    return status;
+}
+
+/* Implements unset name ...: removes each variable
+
+Arguments are those of builtin_function
+
+Returns:
+    0 if successful
+    1 if a name was not valid
+*/
+static int builtin_unset(int argc, char *argv[], int in, int out) {
+    int status = 0;
+
+    for (int i = 1; i < argc; i++) {
+        if (!env_valid_name(argv[i], mystrlen(argv[i]))) {
+            status = builtin_error(argv[i], identifierError);
+            continue;
+        }
+        env_unset(argv[i]);
+    }
+    return status;
+}
+
+/* Implements exit [n]: ends the shell with status n, or the status of the
+last job. In a pipeline or with & only the forked copy running it exits
+
+Arguments are those of builtin_function
+
+Returns:
+    1 if there were too many arguments (the shell keeps running)
+    does not return otherwise
+*/
+static int builtin_exit(int argc, char *argv[], int in, int out) {
+    const struct JobResult *result = last_job_result();
+    long status = result->statuses[result->num_stages - 1];
+
+    if (argc > 2) {
+        return builtin_error(argv[0], tooManyError);
+    }
+    if (argc == 2 && myatoi(argv[1], &status) != 0) {
+        builtin_error(argv[1], numericError);
+        status = 2;
+    }
+    exit(status & 0xff);
+}
+
+/* Implements history [prefix]: lists the entries of the command history
+that start with prefix, or all of them, oldest first with their numbers
+
+Arguments are those of builtin_function
+
+Returns:
+    0 if successful
+    2 if the arguments were invalid
+*/
+static int builtin_history(int argc, char *argv[], int in, int out) {
+    if (argc > 2) {
+        write(1, historyUsageError, 24);
+        return 2;
+    }
+    if (history_enabled()) {
+        print_history(out, argc == 2 ? argv[1] : "");
+    }
+    return 0;
+}
+
+/* Evaluates a test with one operator and one operand, such as -f path
+
+op - the operator
+arg - the operand
+
+Returns:
+    0 if true
+    1 if false
+    2 if the operator is unknown (error already printed)
+*/
+static int test_unary(const char *op, const char *arg) {
+    struct stat info;
+
+    if (op[0] != '-' || op[1] == '\0' || op[2] != '\0') {
+        return builtin_error(op, operatorError) + 1;
+    }
+    switch (op[1]) {
+        case 'n':
+            return arg[0] == '\0';
+        case 'z':
+            return arg[0] != '\0';
+        case 'e':
+            return stat(arg, &info) != 0;
+        case 'f':
+            return stat(arg, &info) != 0 || !S_ISREG(info.st_mode);
+        case 'd':
+            return stat(arg, &info) != 0 || !S_ISDIR(info.st_mode);
+        case 's':
+            return stat(arg, &info) != 0 || info.st_size == 0;
+        case 'L':
+        case 'h':
+            return lstat(arg, &info) != 0 || !S_ISLNK(info.st_mode);
+        case 'r':
+            return access(arg, R_OK) != 0;
+        case 'w':
+            return access(arg, W_OK) != 0;
+        case 'x':
+            return access(arg, X_OK) != 0;
+    }
+    return builtin_error(op, operatorError) + 1;
+}
+
+/* Evaluates a test comparing two operands, such as a = b or 3 -lt 5
+
+left - the first operand
+op - the operator
+right - the second operand
+
+Returns:
+    0 if true
+    1 if false
+    2 if the operator is unknown or an integer operand is not a number (error already printed)
+*/
+static int test_binary(const char *left, const char *op, const char *right) {
+    static const char *integerOps[] = {"-eq", "-ne", "-lt", "-le", "-gt", "-ge"};
+    long a;
+    long b;
+
+    if (mystrcmp(op, "=") == 0 || mystrcmp(op, "==") == 0) {
+        return mystrcmp(left, right) != 0;
+    }
+    if (mystrcmp(op, "!=") == 0) {
+        return mystrcmp(left, right) == 0;
+    }
+    for (int i = 0; i < 6; i++) {
+        if (mystrcmp(op, integerOps[i]) != 0) {
+            continue;
+        }
+        if (myatoi(left, &a) != 0) {
+            return builtin_error(left, integerError) + 1;
+        }
+        if (myatoi(right, &b) != 0) {
+            return builtin_error(right, integerError) + 1;
+        }
+        switch (i) {
+            case 0: return !(a == b);
+            case 1: return !(a != b);
+            case 2: return !(a < b);
+            case 3: return !(a <= b);
+            case 4: return !(a > b);
+            default: return !(a >= b);
+        }
+    }
+    return builtin_error(op, operatorError) + 1;
+}
+
+/* Implements test expression and [ expression ]: the forms with no
+operand, one string, a unary file or string test, or a binary string or
+integer comparison, each optionally negated by a leading !
+
+Arguments are those of builtin_function
+
+Returns:
+    0 if the expression is true
+    1 if it is false
+    2 if it is malformed
+*/
+static int builtin_test(int argc, char *argv[], int in, int out) {
+    char **args = argv + 1;
+    int count = argc - 1;
+    int negate = 0;
+    int result;
+
+    if (mystrcmp(argv[0], "[") == 0) {
+        if (argc < 2 || mystrcmp(argv[argc - 1], "]") != 0) {
+            write(1, bracketError, 13);
+            return 2;
+        }
+        count -= 1;
+    }
+    // ! with something after it negates, a lone ! is just a non-empty string
+    if (count > 1 && mystrcmp(args[0], "!") == 0) {
+        negate = 1;
+        args += 1;
+        count -= 1;
+    }
+    switch (count) {
+        case 0:
+            result = 1;
+            break;
+        case 1:
+            result = args[0][0] == '\0';
+            break;
+        case 2:
+            result = test_unary(args[0], args[1]);
+            break;
+        case 3:
+            result = test_binary(args[0], args[1], args[2]);
+            break;
+        default:
+            return builtin_error(argv[0], tooManyError) + 1;
+    }
+    if (result == 2) {
+        return 2;
+    }
+    return negate ? !result : result;
+}
+
+static const struct Builtin builtins[] = {
+    {"hash", builtin_hash, 0},
+    {"jobs", builtin_jobs, 0},
+    {"fg", builtin_fg, 0},
+    {"bg", builtin_bg, 0},
+    {"wait", builtin_wait, 0},
+    {"parallel", builtin_parallel, 0},
+    {"cat", builtin_cat, BUILTIN_MOVES_DATA},
+    {"tee", builtin_tee, BUILTIN_MOVES_DATA},
+    {"pipesize", builtin_pipesize, 0},
+    {"cd", builtin_cd, 0},
+    {"pwd", builtin_pwd, BUILTIN_NO_STATE},
+    {"echo", builtin_echo, BUILTIN_NO_STATE},
+    {"true", builtin_true, BUILTIN_NO_STATE},
+    {"false", builtin_false, BUILTIN_NO_STATE},
+    {"export", builtin_export, 0},
+    {"unset", builtin_unset, 0},
+    {"exit", builtin_exit, 0},
+    {"history", builtin_history, 0},
+    {"test", builtin_test, BUILTIN_NO_STATE},
+    {"[", builtin_test, BUILTIN_NO_STATE},
+};
+
+/* Open addressed table of the builtins, indexed by the hash of their names */
+static const struct Builtin *builtinTable[BUILTIN_TABLE_SIZE];
+static int tableBuilt = 0;
+
+
+/* Hashes a builtin name with FNV-1a
+
+name - the null terminated name to hash
+
+Returns:
+    the first slot to probe for the name
+*/
+static unsigned int hash_builtin(const char *name) {
+    unsigned int hash = 2166136261u;
+
+    while (*name != '\0') {
+        hash ^= (unsigned char)*name;
+        hash *= 16777619u;
+        name += 1;
+    }
+    return hash & (BUILTIN_TABLE_SIZE - 1);
+}
+
+/* Finds the table entry of a builtin, filling the table on first use.
+Every command name is looked up before it is run, so most lookups are misses
+that end at the first empty slot without comparing strings
+
+name - the command name (argv[0])
+
+Returns:
+    the builtin
+    NULL if the name is not a builtin
+*/
+static const struct Builtin *lookup_builtin(const char *name) {
+    unsigned int slot;
+
+    if (!tableBuilt) {
+        for (unsigned int i = 0; i < sizeof(builtins) / sizeof(builtins[0]); i++) {
+            slot = hash_builtin(builtins[i].name);
+            while (builtinTable[slot] != NULL) {
+                slot = (slot + 1) & (BUILTIN_TABLE_SIZE - 1);
+            }
+            builtinTable[slot] = &builtins[i];
+        }
+        tableBuilt = 1;
+    }
+    for (slot = hash_builtin(name); builtinTable[slot] != NULL; slot = (slot + 1) & (BUILTIN_TABLE_SIZE - 1)) {
+        if (mystrcmp(builtinTable[slot]->name, name) == 0) {
+            return builtinTable[slot];
+        }
+    }
+    return NULL;
+}
+
+builtin_function find_builtin(const char *name) {
+    const struct Builtin *builtin = lookup_builtin(name);
+
+    return builtin != NULL ? builtin->function : NULL;
+}
+
+builtin_function find_data_mover(const char *name) {
+    const struct Builtin *builtin = lookup_builtin(name);
+
+    return builtin != NULL && (builtin->flags & BUILTIN_MOVES_DATA) ? builtin->function : NULL;
+}
+
+builtin_function find_pipeline_builtin(const char *name) {
+    const struct Builtin *builtin = lookup_builtin(name);
+
+    return builtin != NULL && (builtin->flags & (BUILTIN_MOVES_DATA | BUILTIN_NO_STATE)) ? builtin->function : NULL;
+}
+
+const char *builtin_name(unsigned int index) {
+    return index < sizeof(builtins) / sizeof(builtins[0]) ? builtins[index].name : NULL;
+}
@@ -0,0 +1,59 @@
+#ifndef BUILTINS_H
+#define BUILTINS_H
+
+/* A command run inside the shell instead of in a new process
+
+argc - the number of arguments
+argv - the NULL terminated arguments, argv[0] is the command name
+in - file descriptor to read input from
+out - file descriptor to write output to
+
+Returns:
+    the exit status of the command
+*/
+typedef int (*builtin_function)(int argc, char *argv[], int in, int out);
+
+/* Looks up a builtin command by name in a hash table of the builtins
+
+name - the command name (argv[0])
+
+Returns:
+    the function implementing the command
+    NULL if the name is not a builtin
+*/
+builtin_function find_builtin(const char *name);
+
+/* Looks up a builtin that only moves data between its input, its output and
+files. Such a builtin is safe to run inside the shell as one stage of a pipeline
+
+name - the command name (argv[0])
+
+Returns:
+    the function implementing the command
+    NULL if the name is not a data moving builtin
+*/
+builtin_function find_data_mover(const char *name);
+
+/* Looks up a builtin that may run inside the shell as the last stage of a
+pipeline: a data moving builtin, or one that only reads its arguments and
+writes its output (echo, pwd, true, false, test)
+
+name - the command name (argv[0])
+
+Returns:
+    the function implementing the command
+    NULL if the name is not such a builtin
+*/
+builtin_function find_pipeline_builtin(const char *name);
+
+/* Returns the name of a builtin, so every builtin can be listed by counting up from 0
+
+index - the position of the builtin in the table
+
+Returns:
+    the name
+    NULL if index is past the last builtin
+*/
+const char *builtin_name(unsigned int index);
+
+#endif
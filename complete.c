@@ -0,0 +1,367 @@
+#include "complete.h"
+#include "builtins.h"
+#include "env.h"
+#include "myheap.h"
+#include "mystring.h"
+#include <unistd.h>
+#include <string.h>
+#include <dirent.h>
+#include <fcntl.h>
+#include <time.h>
+#include <sys/stat.h>
+
+#define COMPLETE_BLOCK_SIZE 4096    /* bytes print_completions gathers before each write */
+
+/* One character of the trie. Children are kept in character order, so the
+names below a node come out sorted */
+struct TrieNode
+{
+  struct TrieNode *child;       /* first child, NULL for none */
+  struct TrieNode *sibling;     /* next child of the same parent */
+  unsigned int count;           /* names ending at or below this node */
+  char c;
+  char terminal;                /* 1 if a name ends here */
+};
+
+/* An executable found in a directory */
+struct CommandName
+{
+  struct CommandName *next;
+  char name[];
+};
+
+/* A directory of $PATH and the executables read from it */
+struct CommandDir
+{
+  char *path;
+  int valid;                    /* 1 once the directory has been looked at */
+  struct timespec mtime;        /* 0 if the directory does not exist */
+  time_t read_at;               /* when reading started, a listing read in the same second as a change is not trusted */
+  struct CommandName *names;
+  struct Arena arena;           /* holds names */
+};
+
+/* Output gathered into blocks while the trie is walked */
+struct Block
+{
+  int out;
+  char data[COMPLETE_BLOCK_SIZE];
+  unsigned int used;
+  unsigned int left;            /* names still allowed */
+};
+
+static struct CommandDir dirs[COMPLETE_MAX_DIRS];
+static unsigned int numDirs = 0;
+static struct Arena pathArena;      /* holds indexedPath and the directory paths */
+static char *indexedPath = NULL;    /* the $PATH the directories were taken from */
+static struct Arena trieArena;
+static struct TrieNode *root = NULL;
+
+
+/* Splits $PATH into directories if it changed since the last completion,
+forgetting what was read from the old ones
+
+path - the value of $PATH
+
+Returns:
+    1 if the directories changed
+    0 if not
+    -1 if out of memory
+*/
+static int set_dirs(const char *path) {
+    unsigned int length = mystrlen(path);
+    unsigned int start = 0;
+
+    if (indexedPath != NULL && mystrcmp(indexedPath, path) == 0) {
+        return 0;
+    }
+    arena_reset(&pathArena);
+    for (unsigned int i = 0; i < numDirs; i++) {
+        arena_reset(&dirs[i].arena);
+        dirs[i].valid = 0;
+        dirs[i].names = NULL;
+    }
+    numDirs = 0;
+    indexedPath = arena_alloc(&pathArena, length + 1);
+    if (indexedPath == NULL) {
+        return -1;
+    }
+    memcpy(indexedPath, path, length + 1);
+
+    for (unsigned int i = 0; i <= length && numDirs < COMPLETE_MAX_DIRS; i++) {
+        if (i < length && path[i] != ':') {
+            continue;
+        }
+        // an empty entry is the current directory
+        unsigned int dirLength = i > start ? i - start : 1;
+        char *dir = arena_alloc(&pathArena, dirLength + 1);
+
+        if (dir == NULL) {
+            indexedPath = NULL;
+            return -1;
+        }
+        memcpy(dir, i > start ? path + start : ".", dirLength);
+        dir[dirLength] = '\0';
+        dirs[numDirs++].path = dir;
+        start = i + 1;
+    }
+    return 1;
+}
+
+/* Reads the executables of a directory again if it changed since it was last read
+
+dir - the directory
+
+Returns:
+    1 if the names changed
+    0 if not
+*/
+static int refresh_dir(struct CommandDir *dir) {
+    struct stat info;
+    struct dirent *entry;
+    DIR *stream;
+    time_t readAt;
+
+    if (stat(dir->path, &info) != 0 || !S_ISDIR(info.st_mode)) {
+        info.st_mtim.tv_sec = 0;
+        info.st_mtim.tv_nsec = 0;
+    }
+    if (dir->valid && dir->mtime.tv_sec == info.st_mtim.tv_sec && dir->mtime.tv_nsec == info.st_mtim.tv_nsec
+            && (info.st_mtim.tv_sec == 0 || dir->read_at > info.st_mtim.tv_sec)) {
+        return 0;
+    }
+
+    arena_reset(&dir->arena);
+    dir->names = NULL;
+    dir->valid = 1;
+    dir->mtime = info.st_mtim;
+    readAt = time(NULL);
+    dir->read_at = readAt;
+    stream = info.st_mtim.tv_sec != 0 ? opendir(dir->path) : NULL;
+    if (stream == NULL) {
+        return 1;
+    }
+    while ((entry = readdir(stream)) != NULL) {
+        unsigned int length = mystrlen(entry->d_name);
+        struct CommandName *name;
+
+        // directories are skipped without a stat when the file system says what they are
+        if (entry->d_name[0] == '.' || entry->d_type == DT_DIR || length >= COMPLETE_NAME_MAX) {
+            continue;
+        }
+        if (fstatat(dirfd(stream), entry->d_name, &info, 0) != 0 || !S_ISREG(info.st_mode) || !(info.st_mode & 0111)) {
+            continue;
+        }
+        name = (struct CommandName *)arena_alloc(&dir->arena, sizeof(struct CommandName) + length + 1);
+        if (name == NULL) {
+            break;
+        }
+        memcpy(name->name, entry->d_name, length + 1);
+        name->next = dir->names;
+        dir->names = name;
+    }
+    closedir(stream);
+    return 1;
+}
+
+/* Adds a name to the trie, counting it in every node on its way if it is new
+
+name - the null terminated name, shorter than COMPLETE_NAME_MAX
+
+Returns:
+    0 if successful
+    -1 if out of memory
+*/
+static int insert_name(const char *name) {
+    struct TrieNode *path[COMPLETE_NAME_MAX + 1];
+    struct TrieNode *node = root;
+    unsigned int length = 0;
+
+    path[0] = root;
+    for (; name[length] != '\0'; length++) {
+        struct TrieNode **link = &node->child;
+
+        while (*link != NULL && (unsigned char)(*link)->c < (unsigned char)name[length]) {
+            link = &(*link)->sibling;
+        }
+        if (*link == NULL || (*link)->c != name[length]) {
+            struct TrieNode *added = (struct TrieNode *)arena_alloc(&trieArena, sizeof(struct TrieNode));
+
+            if (added == NULL) {
+                return -1;
+            }
+            added->child = NULL;
+            added->sibling = *link;
+            added->count = 0;
+            added->c = name[length];
+            added->terminal = 0;
+            *link = added;
+        }
+        node = *link;
+        path[length + 1] = node;
+    }
+    if (!node->terminal) {
+        node->terminal = 1;
+        for (unsigned int i = 0; i <= length; i++) {
+            path[i]->count += 1;
+        }
+    }
+    return 0;
+}
+
+/* Builds the trie from the builtins and the names read from each directory
+
+Takes no arguments
+
+Returns:
+    0 if successful
+    -1 if out of memory
+*/
+static int build_trie() {
+    const char *name;
+
+    arena_reset(&trieArena);
+    root = (struct TrieNode *)arena_alloc(&trieArena, sizeof(struct TrieNode));
+    if (root == NULL) {
+        return -1;
+    }
+    memset(root, 0, sizeof(struct TrieNode));
+    for (unsigned int i = 0; (name = builtin_name(i)) != NULL; i++) {
+        if (insert_name(name) != 0) {
+            root = NULL;
+            return -1;
+        }
+    }
+    for (unsigned int i = 0; i < numDirs; i++) {
+        for (struct CommandName *entry = dirs[i].names; entry != NULL; entry = entry->next) {
+            if (insert_name(entry->name) != 0) {
+                root = NULL;
+                return -1;
+            }
+        }
+    }
+    return 0;
+}
+
+/* Brings the trie up to date with $PATH and its directories
+
+Takes no arguments
+
+Returns:
+    0 if successful
+    -1 if out of memory
+*/
+static int update_index() {
+    const char *path = env_get("PATH");
+    int changed = set_dirs(path != NULL ? path : "");
+
+    if (changed == -1) {
+        return -1;
+    }
+    for (unsigned int i = 0; i < numDirs; i++) {
+        changed |= refresh_dir(&dirs[i]);
+    }
+    if (changed || root == NULL) {
+        return build_trie();
+    }
+    return 0;
+}
+
+/* Walks the trie along a prefix
+
+prefix - the characters to follow
+length - the number of characters in prefix
+
+Returns:
+    the node of the last character, the root for an empty prefix
+    NULL if no name starts with the prefix
+*/
+static struct TrieNode *find_prefix(const char *prefix, unsigned int length) {
+    struct TrieNode *node = root;
+
+    for (unsigned int i = 0; i < length && node != NULL; i++) {
+        node = node->child;
+        while (node != NULL && node->c != prefix[i]) {
+            node = node->sibling;
+        }
+    }
+    return node;
+}
+
+int complete_command(const char *prefix, unsigned int length, char *common) {
+    struct TrieNode *node;
+    unsigned int added = 0;
+
+    common[0] = '\0';
+    if (update_index() != 0) {
+        return -1;
+    }
+    node = find_prefix(prefix, length);
+    if (node == NULL || length >= COMPLETE_NAME_MAX) {
+        return 0;
+    }
+    // every match shares the characters down to the first fork or name end
+    for (struct TrieNode *next = node; !next->terminal && next->child != NULL && next->child->sibling == NULL; ) {
+        next = next->child;
+        if (length + added + 1 >= COMPLETE_NAME_MAX) {
+            break;
+        }
+        common[added++] = next->c;
+    }
+    common[added] = '\0';
+    return node->count;
+}
+
+/* Adds text to a block, writing the block out when it fills */
+static void block_add(struct Block *block, const char *text, unsigned int length) {
+    if (block->used + length > COMPLETE_BLOCK_SIZE) {
+        write(block->out, block->data, block->used);
+        block->used = 0;
+    }
+    memcpy(block->data + block->used, text, length);
+    block->used += length;
+}
+
+/* Writes every name at or below a node in order
+
+node - the node
+name - the characters leading to node, with room for COMPLETE_NAME_MAX
+length - the number of characters in name
+block - where the names go
+
+No return values
+*/
+static void print_below(struct TrieNode *node, char *name, unsigned int length, struct Block *block) {
+    if (block->left == 0) {
+        return;
+    }
+    if (node->terminal) {
+        block_add(block, name, length);
+        block_add(block, "  ", 2);
+        block->left -= 1;
+    }
+    for (struct TrieNode *child = node->child; child != NULL && length + 1 < COMPLETE_NAME_MAX; child = child->sibling) {
+        name[length] = child->c;
+        print_below(child, name, length + 1, block);
+    }
+}
+
+void print_completions(int out, const char *prefix, unsigned int length, unsigned int max) {
+    static struct Block block;
+    char name[COMPLETE_NAME_MAX];
+    struct TrieNode *node;
+
+    if (update_index() != 0 || length >= COMPLETE_NAME_MAX || (node = find_prefix(prefix, length)) == NULL) {
+        return;
+    }
+    memcpy(name, prefix, length);
+    block.out = out;
+    block.used = 0;
+    block.left = max;
+    print_below(node, name, length, &block);
+    if (node->count > max) {
+        block_add(&block, "...", 3);
+    }
+    block_add(&block, "\n", 1);
+    write(out, block.data, block.used);
+}
@@ -0,0 +1,40 @@
+#ifndef COMPLETE_H
+#define COMPLETE_H
+
+#define COMPLETE_MAX_DIRS 64        /* directories of $PATH indexed, later ones are ignored */
+#define COMPLETE_NAME_MAX 256       /* longest command name indexed */
+
+/* Command name completion. The builtins and the executables of every $PATH
+directory are held in a prefix trie, built the first time a completion is
+asked for. The names of each directory are kept separately and read again
+only when that directory's mtime changes (or $PATH does), after which the
+trie is rebuilt from memory. Each node counts the names below it, so a
+completion walks only the prefix and the part all matches share */
+
+/* Finds the command names that start with a prefix
+
+prefix - the start of the name, need not be null terminated
+length - the number of characters in prefix
+common - filled with the characters every match has after the prefix, null
+         terminated, COMPLETE_NAME_MAX bytes
+
+Returns:
+    the number of names that match
+    -1 if the index could not be built
+*/
+int complete_command(const char *prefix, unsigned int length, char *common);
+
+/* Writes the command names that start with a prefix in sorted order, two
+spaces apart and followed by a newline, with "..." after them if there
+were more than max
+
+out - the file descriptor to write to
+prefix - the start of the name, need not be null terminated
+length - the number of characters in prefix
+max - the most names to write
+
+No return values
+*/
+void print_completions(int out, const char *prefix, unsigned int length, unsigned int max);
+
+#endif
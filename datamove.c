@@ -0,0 +1,280 @@
+#define _GNU_SOURCE
+#include "datamove.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <errno.h>
+#include <signal.h>
+#include <sys/stat.h>
+
+#define MOVE_CHUNK 1048576      /* most bytes asked of the kernel in one call */
+#define COPY_BUFFER 65536       /* size of the buffer used by the read/write fallback */
+
+#define METHOD_COPY_RANGE 0     /* copy_file_range, both ends regular files */
+#define METHOD_SPLICE     1     /* splice, at least one end a pipe */
+#define METHOD_READ_WRITE 2     /* plain read and write through a buffer */
+
+static volatile sig_atomic_t moveInterrupted = 0;
+static struct sigaction previousInterrupt;
+
+
+/* Notes that Ctrl-C was pressed so the copy stops at the next system call
+
+sig - the signal number (SIGINT)
+
+No return values
+*/
+static void on_move_interrupt(int sig) {
+    moveInterrupted = 1;
+}
+
+/* Catches SIGINT for the length of a copy. SA_RESTART is left out so a
+blocked splice or read returns EINTR
+
+Takes no arguments
+No return values
+*/
+static void catch_interrupt() {
+    struct sigaction action;
+
+    moveInterrupted = 0;
+    action.sa_handler = on_move_interrupt;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = 0;
+    sigaction(SIGINT, &action, &previousInterrupt);
+}
+
+/* Puts back the SIGINT disposition from before catch_interrupt
+
+Takes no arguments
+No return values
+*/
+static void release_interrupt() {
+    sigaction(SIGINT, &previousInterrupt, NULL);
+}
+
+/* Finds out what kind of file a descriptor refers to
+
+fd - the descriptor to check
+
+Returns:
+    the S_IFMT bits of its mode
+    0 if fstat failed
+*/
+static int file_kind(int fd) {
+    struct stat info;
+
+    if (fstat(fd, &info) == -1) {
+        return 0;
+    }
+    return info.st_mode & S_IFMT;
+}
+
+/* Writes all of a buffer, continuing after short writes
+
+fd - the descriptor to write to
+buffer - the bytes to write
+length - the number of bytes
+
+Returns:
+    0 if successful
+    -1 if write failed
+*/
+static int write_all(int fd, const char *buffer, long length) {
+    long written;
+
+    while (length > 0) {
+        written = write(fd, buffer, length);
+        if (written == -1) {
+            if (errno == EINTR && !moveInterrupted) {
+                continue;
+            }
+            return -1;
+        }
+        buffer += written;
+        length -= written;
+    }
+    return 0;
+}
+
+/* Whether an error from copy_file_range or splice means the call can't be
+used on these descriptors, rather than that the copy went wrong
+
+error - the errno value
+
+Returns:
+    1 if a slower method should be tried
+    0 otherwise
+*/
+static int unsupported(int error) {
+    return error == EINVAL || error == ENOSYS || error == EXDEV || error == EOPNOTSUPP || error == EBADF;
+}
+
+/* Moves up to one chunk with the given method
+
+method - METHOD_COPY_RANGE, METHOD_SPLICE or METHOD_READ_WRITE
+in - descriptor to read from
+out - descriptor to write to
+buffer - COPY_BUFFER bytes for METHOD_READ_WRITE
+
+Returns:
+    the number of bytes moved
+    0 at end of input
+    -1 on error, with errno set
+*/
+static long move_step(int method, int in, int out, char *buffer) {
+    long length;
+
+    if (method == METHOD_COPY_RANGE) {
+        return copy_file_range(in, NULL, out, NULL, MOVE_CHUNK, 0);
+    }
+    if (method == METHOD_SPLICE) {
+        return splice(in, NULL, out, NULL, MOVE_CHUNK, SPLICE_F_MOVE | SPLICE_F_MORE);
+    }
+    length = read(in, buffer, COPY_BUFFER);
+    if (length > 0 && write_all(out, buffer, length) == -1) {
+        return -1;
+    }
+    return length;
+}
+
+int move_data(int in, int out) {
+    char buffer[COPY_BUFFER];
+    int inKind = file_kind(in);
+    int outKind = file_kind(out);
+    int method = METHOD_READ_WRITE;
+    int moved = 0;
+    int result = 0;
+    long length;
+
+    if (inKind == S_IFREG && outKind == S_IFREG) {
+        method = METHOD_COPY_RANGE;
+    } else if (inKind == S_IFIFO || outKind == S_IFIFO) {
+        method = METHOD_SPLICE;
+    }
+
+    catch_interrupt();
+    while (1) {
+        length = move_step(method, in, out, buffer);
+        if (length > 0) {
+            moved = 1;
+            continue;
+        }
+        if (length == 0) {
+            // copy_file_range also returns 0 where it can't copy (e.g. procfs), so check with read
+            if (method == METHOD_COPY_RANGE && !moved) {
+                method = METHOD_READ_WRITE;
+                continue;
+            }
+            break;
+        }
+        if (errno == EINTR && !moveInterrupted) {
+            continue;
+        }
+        // nothing has been consumed yet by a refused call, so the next method starts where it stopped
+        if (method != METHOD_READ_WRITE && unsupported(errno)) {
+            method = method == METHOD_COPY_RANGE && (inKind == S_IFIFO || outKind == S_IFIFO) ? METHOD_SPLICE : METHOD_READ_WRITE;
+            continue;
+        }
+        if (moveInterrupted) {
+            errno = EINTR;
+        }
+        result = -1;
+        break;
+    }
+    release_interrupt();
+    return result;
+}
+
+/* Duplicates one chunk of a pipe into another pipe with tee, then splices
+the same bytes out of the input pipe into a file
+
+in - the input pipe
+out - the output pipe
+file - the file to receive a copy
+
+Returns:
+    the number of bytes moved
+    0 at end of input
+    -1 on error, with errno set
+    -2 if tee refused the pipes (nothing was moved)
+*/
+static long tee_step(int in, int out, int file) {
+    long length = tee(in, out, MOVE_CHUNK, 0);
+    long left = length;
+    long spliced;
+
+    if (length == -1 && unsupported(errno)) {
+        return -2;
+    }
+
+    while (left > 0) {
+        spliced = splice(in, NULL, file, NULL, left, SPLICE_F_MOVE | SPLICE_F_MORE);
+        if (spliced == -1 && errno == EINTR && !moveInterrupted) {
+            continue;
+        }
+        if (spliced <= 0) {
+            return -1;
+        }
+        left -= spliced;
+    }
+    return length;
+}
+
+int tee_data(int in, int out, int *files, int count) {
+    char buffer[COPY_BUFFER];
+    int useTee = count == 1 && file_kind(in) == S_IFIFO && file_kind(out) == S_IFIFO;
+    int result = 0;
+    long length;
+
+    // splice can't write to a file opened for appending
+    if (useTee && (!(file_kind(files[0]) == S_IFREG || file_kind(files[0]) == S_IFIFO)
+                   || (fcntl(files[0], F_GETFL) & O_APPEND))) {
+        useTee = 0;
+    }
+
+    catch_interrupt();
+    while (1) {
+        if (useTee) {
+            length = tee_step(in, out, files[0]);
+            if (length == -2) {
+                useTee = 0;
+                continue;
+            }
+        } else {
+            length = read(in, buffer, COPY_BUFFER);
+            if (length > 0) {
+                if (write_all(out, buffer, length) == -1) {
+                    length = -1;
+                }
+                for (int i = 0; i < count && length > 0; i++) {
+                    if (write_all(files[i], buffer, length) == -1) {
+                        length = -1;
+                    }
+                }
+            }
+        }
+        if (length > 0) {
+            continue;
+        }
+        if (length == 0) {
+            break;
+        }
+        if (errno == EINTR && !moveInterrupted) {
+            continue;
+        }
+        if (moveInterrupted) {
+            errno = EINTR;
+        }
+        result = -1;
+        break;
+    }
+    release_interrupt();
+    return result;
+}
+
+int take_move_interrupt() {
+    int taken = moveInterrupted;
+
+    moveInterrupted = 0;
+    return taken;
+}
@@ -0,0 +1,43 @@
+#ifndef DATAMOVE_H
+#define DATAMOVE_H
+
+/* Copies everything from one file descriptor to another inside the kernel
+where possible: copy_file_range between regular files, splice when either
+side is a pipe, and read/write through a buffer for anything else (or when
+the kernel refuses the faster call). Ctrl-C ends the copy early
+
+in - file descriptor to read until end of input
+out - file descriptor to write to
+
+Returns:
+    0 if everything was copied
+    -1 if the copy failed or was interrupted, with errno set (EINTR for Ctrl-C,
+       EPIPE if the reader of out went away)
+*/
+int move_data(int in, int out);
+
+/* Copies everything from one file descriptor to another and to every given
+file. When in and out are both pipes and there is one file, the data is
+duplicated with tee and spliced to the file without passing through the shell
+
+in - file descriptor to read until end of input
+out - file descriptor to write to
+files - further file descriptors to write to
+count - the number of entries in files
+
+Returns:
+    the same values as move_data
+*/
+int tee_data(int in, int out, int *files, int count);
+
+/* Tells whether Ctrl-C ended a copy since the last call, and forgets it
+
+Takes no arguments
+
+Returns:
+    1 if a copy was interrupted by SIGINT
+    0 otherwise
+*/
+int take_move_interrupt();
+
+#endif
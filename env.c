@@ -0,0 +1,313 @@
+#include "env.h"
+#include "myheap.h"
+#include "mystring.h"
+#include <unistd.h>
+#include <string.h>
+
+/* One variable of the store */
+struct Variable
+{
+  char *text;               /* "NAME=value", null terminated */
+  unsigned int name_length; /* characters before the = */
+  int exported;             /* 1 if passed to new processes */
+};
+
+/* Text, the table and envp live in one of two arenas. Replaced text is left
+where it is until enough has piled up, then everything still in use is
+copied to the other arena and the old one is reset */
+static struct Arena arenas[2];
+static int current = 0;
+static struct Variable *variables = NULL;
+static unsigned int numVariables = 0;
+static unsigned int maxVariables = 0;
+static char **envp = NULL;          /* exported variables, NULL when it must be rebuilt */
+static unsigned long envpBytes = 0; /* size of envp, counted as garbage once it is dropped */
+static unsigned long garbage = 0;   /* bytes of the current arena no longer referenced */
+
+
+int env_valid_name(const char *name, int length) {
+    if (length == 0 || (name[0] >= '0' && name[0] <= '9')) {
+        return 0;
+    }
+    for (int i = 0; i < length; i++) {
+        char c = name[i];
+        if (!(c == '_' || (c >= 'a' && c <= 'z') || (c >= 'A' && c <= 'Z') || (c >= '0' && c <= '9'))) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+/* Counts the characters of "NAME=value" text before the =
+
+text - the text
+
+Returns:
+    the length of the name (the whole text if there is no =)
+*/
+static unsigned int name_length(const char *text) {
+    unsigned int length = 0;
+
+    while (text[length] != '\0' && text[length] != '=') {
+        length += 1;
+    }
+    return length;
+}
+
+/* Finds a variable in the table
+
+name - the name, need not be null terminated
+length - the number of characters in the name
+
+Returns:
+    the index of the variable
+    -1 if it is not set
+*/
+static int find_variable(const char *name, unsigned int length) {
+    for (unsigned int i = 0; i < numVariables; i++) {
+        if (variables[i].name_length == length && memcmp(variables[i].text, name, length) == 0) {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Forgets the envp array so the next env_envp builds it again
+
+Takes no arguments
+No return values
+*/
+static void drop_envp() {
+    if (envp != NULL) {
+        garbage += envpBytes;
+        envp = NULL;
+    }
+}
+
+/* Copies everything still in use to the other arena once enough replaced
+text has piled up in the current one. Nothing changes if the copy fails
+
+Takes no arguments
+No return values
+*/
+static void compact() {
+    struct Arena *to = &arenas[1 - current];
+    struct Variable *table;
+
+    if (garbage < ENV_COMPACT_BYTES) {
+        return;
+    }
+    arena_reset(to);
+    table = (struct Variable *)arena_alloc(to, sizeof(struct Variable) * maxVariables);
+    if (table == NULL) {
+        return;
+    }
+    for (unsigned int i = 0; i < numVariables; i++) {
+        unsigned int length = mystrlen(variables[i].text) + 1;
+
+        table[i] = variables[i];
+        table[i].text = arena_alloc(to, length);
+        if (table[i].text == NULL) {
+            arena_reset(to);
+            return;
+        }
+        memcpy(table[i].text, variables[i].text, length);
+    }
+    drop_envp();
+    arena_reset(&arenas[current]);
+    current = 1 - current;
+    variables = table;
+    garbage = 0;
+}
+
+/* Stores a variable, replacing any earlier value
+
+name - the name, need not be null terminated
+length - the number of characters in the name
+value - the null terminated value
+exported - 1 to export the variable, 0 to leave its exported state alone
+
+Returns:
+    0 if successful
+    -1 if out of memory
+*/
+static int store_variable(const char *name, unsigned int length, const char *value, int exported) {
+    unsigned int valueLength = mystrlen(value);
+    char *text = arena_alloc(&arenas[current], length + valueLength + 2);
+    int index = find_variable(name, length);
+
+    if (text == NULL) {
+        return -1;
+    }
+    memcpy(text, name, length);
+    text[length] = '=';
+    memcpy(text + length + 1, value, valueLength + 1);
+
+    if (index >= 0) {
+        garbage += mystrlen(variables[index].text) + 1;
+        variables[index].text = text;
+        variables[index].exported |= exported;
+    } else {
+        if (numVariables == maxVariables) {
+            unsigned int newMax = maxVariables == 0 ? ENV_INITIAL_VARIABLES : maxVariables * 2;
+            struct Variable *table = (struct Variable *)arena_alloc(&arenas[current], sizeof(struct Variable) * newMax);
+
+            if (table == NULL) {
+                return -1;
+            }
+            if (numVariables > 0) {
+                memcpy(table, variables, sizeof(struct Variable) * numVariables);
+            }
+            garbage += sizeof(struct Variable) * maxVariables;
+            variables = table;
+            maxVariables = newMax;
+        }
+        variables[numVariables].text = text;
+        variables[numVariables].name_length = length;
+        variables[numVariables].exported = exported;
+        numVariables += 1;
+    }
+    drop_envp();
+    compact();
+    return 0;
+}
+
+int env_init(char **initial) {
+    for (unsigned int i = 0; initial[i] != NULL; i++) {
+        unsigned int length = name_length(initial[i]);
+
+        if (initial[i][length] == '=' && store_variable(initial[i], length, initial[i] + length + 1, 1) != 0) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+const char *env_get(const char *name) {
+    unsigned int length = mystrlen(name);
+    int index = find_variable(name, length);
+
+    return index >= 0 ? variables[index].text + length + 1 : NULL;
+}
+
+int env_assign(const char *assignment, int exported) {
+    unsigned int length = name_length(assignment);
+
+    return store_variable(assignment, length, assignment + length + 1, exported);
+}
+
+int env_set(const char *name, const char *value, int exported) {
+    return store_variable(name, mystrlen(name), value, exported);
+}
+
+int env_export(const char *name) {
+    int index = find_variable(name, mystrlen(name));
+
+    if (index < 0) {
+        return env_set(name, "", 1);
+    }
+    if (!variables[index].exported) {
+        variables[index].exported = 1;
+        drop_envp();
+    }
+    return 0;
+}
+
+void env_unset(const char *name) {
+    int index = find_variable(name, mystrlen(name));
+
+    if (index < 0) {
+        return;
+    }
+    garbage += mystrlen(variables[index].text) + 1;
+    // order does not matter, so the last variable fills the gap
+    variables[index] = variables[numVariables - 1];
+    numVariables -= 1;
+    drop_envp();
+}
+
+char **env_envp() {
+    unsigned int count = 0;
+
+    if (envp != NULL) {
+        return envp;
+    }
+    for (unsigned int i = 0; i < numVariables; i++) {
+        count += variables[i].exported;
+    }
+    envpBytes = sizeof(char *) * (count + 1);
+    envp = (char **)arena_alloc(&arenas[current], envpBytes);
+    if (envp == NULL) {
+        return NULL;
+    }
+    count = 0;
+    for (unsigned int i = 0; i < numVariables; i++) {
+        if (variables[i].exported) {
+            envp[count++] = variables[i].text;
+        }
+    }
+    envp[count] = NULL;
+    return envp;
+}
+
+/* Checks whether a later prefix in a list assigns the same name
+
+assignments - "NAME=value" strings
+count - the number of assignments
+index - the assignment to check
+text - the text whose name to look for
+length - the length of that name
+
+Returns:
+    1 if an assignment after index sets the name
+    0 if not
+*/
+static int assigned_after(char **assignments, unsigned int count, int index, const char *text, unsigned int length) {
+    for (unsigned int i = index + 1; i < count; i++) {
+        if (name_length(assignments[i]) == length && memcmp(assignments[i], text, length) == 0) {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+char **env_envp_with(char **assignments, unsigned int count) {
+    char **base = env_envp();
+    char **result;
+    unsigned int total = 0;
+    unsigned int baseCount = 0;
+
+    if (base == NULL) {
+        return NULL;
+    }
+    while (base[baseCount] != NULL) {
+        baseCount += 1;
+    }
+    result = (char **)alloc(sizeof(char *) * (baseCount + count + 1));
+    if (result == NULL) {
+        return NULL;
+    }
+    // a prefix hides the exported variable of the same name, and a later prefix an earlier one
+    for (unsigned int i = 0; i < baseCount; i++) {
+        if (!assigned_after(assignments, count, -1, base[i], name_length(base[i]))) {
+            result[total++] = base[i];
+        }
+    }
+    for (unsigned int i = 0; i < count; i++) {
+        if (!assigned_after(assignments, count, i, assignments[i], name_length(assignments[i]))) {
+            result[total++] = assignments[i];
+        }
+    }
+    result[total] = NULL;
+    return result;
+}
+
+void print_exports(int out) {
+    for (unsigned int i = 0; i < numVariables; i++) {
+        if (variables[i].exported) {
+            write(out, "export ", 7);
+            write(out, variables[i].text, mystrlen(variables[i].text));
+            write(out, "\n", 1);
+        }
+    }
+}
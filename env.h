@@ -0,0 +1,118 @@
+#ifndef ENV_H
+#define ENV_H
+
+#define ENV_INITIAL_VARIABLES 64    /* room in the variable table before it first grows */
+#define ENV_COMPACT_BYTES 65536     /* replaced text allowed to pile up before the store is copied */
+
+/* The shell's variables. Each is held as "NAME=value" text so exported ones
+can be handed to execve as they are. The envp array of exported variables
+is built once and reused by every launch until a variable changes */
+
+/* Copies the environment the shell was started with into the store, every
+variable exported
+
+initial - NULL terminated "NAME=value" strings, usually environ
+
+Returns:
+    0 if successful
+    -1 if out of memory
+*/
+int env_init(char **initial);
+
+/* Checks that a variable name is a letter or _ followed by letters, digits and _
+
+name - the name, need not be null terminated
+length - the number of characters of name to check
+
+Returns:
+    1 if the name is valid
+    0 if not
+*/
+int env_valid_name(const char *name, int length);
+
+/* Looks up a variable
+
+name - the null terminated name
+
+Returns:
+    the value, valid until the variable next changes
+    NULL if the variable is not set
+*/
+const char *env_get(const char *name);
+
+/* Sets a variable from "NAME=value" text. A variable that is already
+exported stays exported
+
+assignment - the text, the name part must be valid
+exported - 1 to export the variable, 0 to leave its exported state alone
+
+Returns:
+    0 if successful
+    -1 if out of memory
+*/
+int env_assign(const char *assignment, int exported);
+
+/* Sets a variable from a name and a value
+
+name - the null terminated name, must be valid
+value - the null terminated value
+exported - 1 to export the variable, 0 to leave its exported state alone
+
+Returns:
+    0 if successful
+    -1 if out of memory
+*/
+int env_set(const char *name, const char *value, int exported);
+
+/* Marks a variable exported, creating it with an empty value if it is not set
+
+name - the null terminated name, must be valid
+
+Returns:
+    0 if successful
+    -1 if out of memory
+*/
+int env_export(const char *name);
+
+/* Removes a variable
+
+name - the null terminated name
+
+No return values
+*/
+void env_unset(const char *name);
+
+/* Returns the environment for a new process: every exported variable.
+The array is only rebuilt after a variable changed, so launching costs
+no allocation in the common case
+
+Takes no arguments
+
+Returns:
+    the NULL terminated envp array, valid until a variable changes
+    NULL if out of memory
+*/
+char **env_envp();
+
+/* Builds the environment for a command with VAR=value prefixes: the
+exported variables with the prefixes added or replacing them. The array is
+allocated on the job heap and the prefixes are not stored
+
+assignments - "NAME=value" strings
+count - the number of assignments
+
+Returns:
+    the NULL terminated envp array, valid until the job heap is cleared
+    NULL if out of memory
+*/
+char **env_envp_with(char **assignments, unsigned int count);
+
+/* Writes every exported variable as an export line, e.g. "export HOME=/root"
+
+out - the file descriptor to write to
+
+No return values
+*/
+void print_exports(int out);
+
+#endif
@@ -0,0 +1,748 @@
+#include "expand.h"
+#include "parsejob.h"
+#include "myheap.h"
+#include "mystring.h"
+#include "env.h"
+#include "jobtable.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <string.h>
+#include <dirent.h>
+#include <pwd.h>
+#include <time.h>
+#include <sys/stat.h>
+
+/* The names in one directory, kept until the directory changes */
+struct DirListing
+{
+  int valid;                /* 1 if the entry holds a listing */
+  dev_t device;             /* the directory, by identity rather than by path */
+  ino_t inode;
+  struct timespec mtime;    /* modification time the names were read at */
+  time_t read_at;           /* when reading started, a listing read in the same second as a change is not trusted */
+  char **names;             /* sorted, without . and .. */
+  unsigned int count;
+  struct Arena arena;       /* holds names and their text */
+};
+
+/* Paths a glob has matched so far, on the job heap */
+struct GlobMatches
+{
+  char **paths;
+  unsigned int count;
+  unsigned int max;
+};
+
+static struct DirListing dirCache[DIR_CACHE_ENTRIES];
+static unsigned int nextReplaced = 0;
+
+
+/* Copies a value into an expanded word, marking its special characters so
+they are neither expanded again nor globbed
+
+dest - where the marked value goes, NULL to only measure it
+value - the value
+length - the number of characters of value
+
+Returns:
+    the number of characters written
+*/
+static unsigned int put_value(char *dest, const char *value, unsigned int length) {
+    unsigned int pos = 0;
+
+    for (unsigned int i = 0; i < length; i++) {
+        if (EXPANSION_CHAR(value[i])) {
+            if (dest != NULL) {
+                dest[pos] = QUOTED_CHAR;
+            }
+            pos += 1;
+        }
+        if (dest != NULL) {
+            dest[pos] = value[i];
+        }
+        pos += 1;
+    }
+    return pos;
+}
+
+/* Writes the statuses of the stages of the last job, separated by spaces
+
+dest - where the text goes, NULL to only measure it
+
+Returns:
+    the number of characters written
+*/
+static unsigned int put_pipestatus(char *dest) {
+    const struct JobResult *result = last_job_result();
+    char number[20];
+    unsigned int pos = 0;
+
+    for (unsigned int i = 0; i < result->num_stages; i++) {
+        unsigned int digits = myitoa(result->statuses[i], number);
+
+        if (i > 0) {
+            pos += put_value(dest != NULL ? dest + pos : NULL, " ", 1);
+        }
+        pos += put_value(dest != NULL ? dest + pos : NULL, number, digits);
+    }
+    return pos;
+}
+
+/* Expands the parameter after a $
+
+text - the characters after the $
+used - set to the number of characters of text that named the parameter, 0 if none did
+dest - where the marked value goes, NULL to only measure it
+
+Returns:
+    the number of characters written
+*/
+static unsigned int expand_parameter(const char *text, unsigned int *used, char *dest) {
+    const struct JobResult *result = last_job_result();
+    char name[PARAMETER_NAME_MAX];
+    char number[20];
+    const char *value;
+    unsigned int length = 0;
+    unsigned int start = 0;
+
+    if (text[0] == '?') {
+        *used = 1;
+        return put_value(dest, number, myitoa(result->statuses[result->num_stages - 1], number));
+    }
+    if (text[0] == '$') {
+        *used = 1;
+        return put_value(dest, number, myitoa(getpid(), number));
+    }
+    if (text[0] == '{') {
+        start = 1;
+    }
+    while (env_valid_name(text + start, length + 1)) {
+        length += 1;
+    }
+    if (length == 0 || (start == 1 && text[1 + length] != '}')) {
+        // not a parameter, the $ stays as it is
+        *used = 0;
+        return 0;
+    }
+    *used = start + length + start;
+    if (length == 10 && memcmp(text + start, "PIPESTATUS", 10) == 0) {
+        return put_pipestatus(dest);
+    }
+    if (length >= PARAMETER_NAME_MAX) {
+        return 0;
+    }
+    memcpy(name, text + start, length);
+    name[length] = '\0';
+    value = env_get(name);
+    return value != NULL ? put_value(dest, value, mystrlen(value)) : 0;
+}
+
+/* Expands a ~ or ~user at the start of a word
+
+text - the characters after the ~
+used - set to the number of characters of text that named the user
+dest - where the marked home directory goes, NULL to only measure it
+
+Returns:
+    the number of characters written
+    -1 if there is no such home directory, the ~ stays as it is
+*/
+static int expand_tilde(const char *text, unsigned int *used, char *dest) {
+    char user[PARAMETER_NAME_MAX];
+    const char *home;
+    unsigned int length = 0;
+
+    while (text[length] != '\0' && text[length] != '/') {
+        // anything quoted ends the user name, "~'x'" is not a home directory
+        if (text[length] == QUOTED_CHAR || text[length] == QUOTED_SECTION || length + 1 >= PARAMETER_NAME_MAX) {
+            return -1;
+        }
+        user[length] = text[length];
+        length += 1;
+    }
+    user[length] = '\0';
+    if (length == 0) {
+        home = env_get("HOME");
+    } else {
+        struct passwd *entry = getpwnam(user);
+        home = entry != NULL ? entry->pw_dir : NULL;
+    }
+    if (home == NULL) {
+        return -1;
+    }
+    *used = length;
+    return put_value(dest, home, mystrlen(home));
+}
+
+/* Expands the parameters and the tilde of a word, keeping the marks of
+quoted characters for globbing
+
+word - the word as left by the lexer
+tildeAt - index where a ~ is a home directory, -1 for nowhere
+dest - where the expanded word goes, NULL to only measure it
+
+Returns:
+    the number of characters written, without a null terminator
+*/
+static unsigned int expand_text(const char *word, int tildeAt, char *dest) {
+    unsigned int pos = 0;
+    unsigned int used;
+    unsigned int i = 0;
+    int length;
+
+    while (word[i] != '\0') {
+        char *out = dest != NULL ? dest + pos : NULL;
+
+        if ((int)i == tildeAt && word[i] == '~' && (length = expand_tilde(word + i + 1, &used, out)) >= 0) {
+            pos += length;
+            i += 1 + used;
+            continue;
+        }
+        if (word[i] == '$') {
+            length = expand_parameter(word + i + 1, &used, out);
+            if (used > 0) {
+                pos += length;
+                i += 1 + used;
+                continue;
+            }
+        }
+        // a quoted character keeps its mark until globbing is done
+        if (word[i] == QUOTED_CHAR && word[i + 1] != '\0') {
+            if (out != NULL) {
+                out[0] = word[i];
+                out[1] = word[i + 1];
+            }
+            pos += 2;
+            i += 2;
+            continue;
+        }
+        if (out != NULL) {
+            out[0] = word[i];
+        }
+        pos += 1;
+        i += 1;
+    }
+    return pos;
+}
+
+/* Removes the quoting marks from a word, in place
+
+word - the word
+
+No return values
+*/
+static void strip_marks(char *word) {
+    unsigned int to = 0;
+
+    for (unsigned int from = 0; word[from] != '\0'; from++) {
+        if (word[from] == QUOTED_SECTION) {
+            continue;
+        }
+        if (word[from] == QUOTED_CHAR && word[from + 1] != '\0') {
+            from += 1;
+        }
+        word[to++] = word[from];
+    }
+    word[to] = '\0';
+}
+
+/* Checks a word for an unquoted *, ? or [
+
+word - the expanded word with its marks
+
+Returns:
+    1 if the word is a glob pattern
+    0 if not
+*/
+static int is_pattern(const char *word) {
+    for (unsigned int i = 0; word[i] != '\0'; i++) {
+        if (word[i] == QUOTED_CHAR && word[i + 1] != '\0') {
+            i += 1;
+        } else if (word[i] == '*' || word[i] == '?' || word[i] == '[') {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Needs only the part of a word up to the first unquoted / */
+static int is_component_pattern(const char *pattern, unsigned int length) {
+    for (unsigned int i = 0; i < length; i++) {
+        if (pattern[i] == QUOTED_CHAR && i + 1 < length) {
+            i += 1;
+        } else if (pattern[i] == '*' || pattern[i] == '?' || pattern[i] == '[') {
+            return 1;
+        }
+    }
+    return 0;
+}
+
+/* Matches one character against a bracket expression such as [a-z_] or [!0-9]
+
+pattern - the pattern, at the [
+c - the character to match
+next - set to the character after the closing ]
+
+Returns:
+    1 if the character matches
+    0 if it does not
+    -1 if there is no closing ], so the [ is an ordinary character
+*/
+static int match_bracket(const char *pattern, char c, const char **next) {
+    unsigned int i = 1;
+    int negate = 0;
+    int matched = 0;
+
+    if (pattern[i] == '!' || pattern[i] == '^') {
+        negate = 1;
+        i += 1;
+    }
+    // a ] straight after the [ is part of the set
+    for (int first = 1; pattern[i] != ']' || first; first = 0) {
+        char low = pattern[i];
+        char high;
+
+        if (low == '\0' || low == '/') {
+            return -1;
+        }
+        if (low == QUOTED_SECTION) {
+            i += 1;
+            continue;
+        }
+        if (low == QUOTED_CHAR && pattern[i + 1] != '\0') {
+            low = pattern[++i];
+        }
+        high = low;
+        if (pattern[i + 1] == '-' && pattern[i + 2] != ']' && pattern[i + 2] != '\0') {
+            i += 2;
+            high = pattern[i];
+            if (high == QUOTED_CHAR && pattern[i + 1] != '\0') {
+                high = pattern[++i];
+            }
+        }
+        if ((unsigned char)c >= (unsigned char)low && (unsigned char)c <= (unsigned char)high) {
+            matched = 1;
+        }
+        i += 1;
+    }
+    *next = pattern + i + 1;
+    return matched != negate;
+}
+
+/* Matches a file name against one component of a glob pattern
+
+pattern - the component, with quoting marks
+length - the number of characters of pattern in the component
+name - the file name
+
+Returns:
+    1 if the name matches
+    0 if not
+*/
+static int match_name(const char *pattern, unsigned int length, const char *name) {
+    const char *p = pattern;
+    const char *end = pattern + length;
+    const char *starP = NULL;
+    const char *starName = NULL;
+    const char *next;
+
+    while (*name != '\0') {
+        if (p < end && *p == QUOTED_SECTION) {
+            p += 1;
+            continue;
+        }
+        if (p < end && *p == '*') {
+            starP = ++p;
+            starName = name;
+            continue;
+        }
+        if (p < end && *p == '?') {
+            p += 1;
+            name += 1;
+            continue;
+        }
+        if (p < end && *p == '[') {
+            int result = match_bracket(p, *name, &next);
+            if (result == 1 && next <= end) {
+                p = next;
+                name += 1;
+                continue;
+            }
+            if (result == -1 && *name == '[') {
+                p += 1;
+                name += 1;
+                continue;
+            }
+        } else if (p < end) {
+            char c = *p;
+            unsigned int width = 1;
+
+            if (c == QUOTED_CHAR && p + 1 < end) {
+                c = p[1];
+                width = 2;
+            }
+            if (c == *name) {
+                p += width;
+                name += 1;
+                continue;
+            }
+        }
+        // let the last * swallow one more character and try again
+        if (starP == NULL) {
+            return 0;
+        }
+        p = starP;
+        name = ++starName;
+    }
+    while (p < end && (*p == '*' || *p == QUOTED_SECTION)) {
+        p += 1;
+    }
+    return p == end;
+}
+
+/* Orders two names for qsort */
+static int compare_names(const void *a, const void *b) {
+    return strcmp(*(char *const *)a, *(char *const *)b);
+}
+
+/* Returns the names in a directory, from the cache while the directory
+(found by device and inode, so cd does not confuse it) keeps its mtime
+
+dir - the directory path
+
+Returns:
+    the listing
+    NULL if the directory can't be read or memory ran out
+*/
+static struct DirListing *list_directory(const char *dir) {
+    struct DirListing *listing = NULL;
+    struct stat info;
+    struct dirent *entry;
+    DIR *stream;
+    time_t readAt;
+
+    if (stat(dir, &info) != 0 || !S_ISDIR(info.st_mode)) {
+        return NULL;
+    }
+    for (unsigned int i = 0; i < DIR_CACHE_ENTRIES; i++) {
+        if (dirCache[i].valid && dirCache[i].device == info.st_dev && dirCache[i].inode == info.st_ino) {
+            listing = &dirCache[i];
+            break;
+        }
+    }
+    if (listing != NULL && listing->mtime.tv_sec == info.st_mtim.tv_sec
+            && listing->mtime.tv_nsec == info.st_mtim.tv_nsec && listing->read_at > info.st_mtim.tv_sec) {
+        return listing;
+    }
+    if (listing == NULL) {
+        listing = &dirCache[nextReplaced];
+        nextReplaced = (nextReplaced + 1) % DIR_CACHE_ENTRIES;
+    }
+
+    readAt = time(NULL);
+    stream = opendir(dir);
+    if (stream == NULL) {
+        return NULL;
+    }
+    arena_reset(&listing->arena);
+    listing->valid = 0;
+    listing->count = 0;
+    // names go in a growing array, copied whenever it fills
+    unsigned int max = 64;
+    listing->names = (char **)arena_alloc(&listing->arena, sizeof(char *) * max);
+    while (listing->names != NULL && (entry = readdir(stream)) != NULL) {
+        unsigned int length = mystrlen(entry->d_name);
+        char *name;
+
+        if (entry->d_name[0] == '.' && (length == 1 || (length == 2 && entry->d_name[1] == '.'))) {
+            continue;
+        }
+        if (listing->count == max) {
+            char **grown = (char **)arena_alloc(&listing->arena, sizeof(char *) * max * 2);
+            if (grown != NULL) {
+                memcpy(grown, listing->names, sizeof(char *) * max);
+                max *= 2;
+            }
+            listing->names = grown;
+            if (grown == NULL) {
+                break;
+            }
+        }
+        name = arena_alloc(&listing->arena, length + 1);
+        if (name == NULL) {
+            listing->names = NULL;
+            break;
+        }
+        memcpy(name, entry->d_name, length + 1);
+        listing->names[listing->count++] = name;
+    }
+    closedir(stream);
+    if (listing->names == NULL) {
+        arena_reset(&listing->arena);
+        return NULL;
+    }
+    qsort(listing->names, listing->count, sizeof(char *), compare_names);
+    listing->device = info.st_dev;
+    listing->inode = info.st_ino;
+    listing->mtime = info.st_mtim;
+    listing->read_at = readAt;
+    listing->valid = 1;
+    return listing;
+}
+
+/* Adds a matched path to a list on the job heap
+
+matches - the list
+path - the path
+length - the number of characters in the path
+
+Returns:
+    0 if successful
+    -1 if the heap is full
+*/
+static int add_match(struct GlobMatches *matches, const char *path, unsigned int length) {
+    char *copy = alloc(length + 1);
+
+    if (copy == NULL) {
+        return -1;
+    }
+    memcpy(copy, path, length);
+    copy[length] = '\0';
+    if (matches->count == matches->max) {
+        unsigned int max = matches->max == 0 ? 16 : matches->max * 2;
+        char **grown = (char **)alloc(sizeof(char *) * max);
+
+        if (grown == NULL) {
+            return -1;
+        }
+        if (matches->count > 0) {
+            memcpy(grown, matches->paths, sizeof(char *) * matches->count);
+        }
+        matches->paths = grown;
+        matches->max = max;
+    }
+    matches->paths[matches->count++] = copy;
+    return 0;
+}
+
+/* Matches the rest of a glob pattern, one path component at a time, below
+the path built so far
+
+pattern - the rest of the pattern, with quoting marks
+path - the path built so far, GLOB_PATH_MAX characters
+length - the number of characters in path
+exists - 1 if path is known to exist
+matches - the list matches are added to
+
+Returns:
+    0 if successful
+    -1 if the heap is full
+*/
+static int glob_from(const char *pattern, char *path, unsigned int length, int exists, struct GlobMatches *matches) {
+    struct stat info;
+    struct DirListing *listing;
+    unsigned int component = 0;
+    int more;
+
+    if (pattern[0] == '\0') {
+        if (!exists && lstat(path, &info) != 0) {
+            return 0;
+        }
+        return add_match(matches, path, length);
+    }
+    while (pattern[component] != '\0' && pattern[component] != '/') {
+        component += 1;
+    }
+    more = pattern[component] == '/';
+
+    if (!is_component_pattern(pattern, component)) {
+        // copy the literal component, without its marks
+        for (unsigned int i = 0; i < component + more; i++) {
+            if (pattern[i] == QUOTED_SECTION) {
+                continue;
+            }
+            if (pattern[i] == QUOTED_CHAR && i + 1 < component) {
+                i += 1;
+            }
+            if (length + 1 >= GLOB_PATH_MAX) {
+                return 0;
+            }
+            path[length++] = pattern[i];
+        }
+        path[length] = '\0';
+        return glob_from(pattern + component + more, path, length, 0, matches);
+    }
+
+    listing = list_directory(length == 0 ? "." : path);
+    if (listing == NULL) {
+        return 0;
+    }
+    for (unsigned int i = 0; i < listing->count; i++) {
+        const char *name = listing->names[i];
+        unsigned int nameLength = mystrlen(name);
+        unsigned int first = 0;
+
+        // hidden names only match a pattern that starts with a dot
+        while (pattern[first] == QUOTED_SECTION || (pattern[first] == QUOTED_CHAR && pattern[first + 1] == '.')) {
+            first += 1;
+        }
+        if (name[0] == '.' && pattern[first] != '.') {
+            continue;
+        }
+        if (!match_name(pattern, component, name) || length + nameLength + 2 >= GLOB_PATH_MAX) {
+            continue;
+        }
+        memcpy(path + length, name, nameLength);
+        if (more) {
+            path[length + nameLength] = '/';
+        }
+        path[length + nameLength + more] = '\0';
+        if (glob_from(pattern + component + more, path, length + nameLength + more, !more, matches) != 0) {
+            return -1;
+        }
+    }
+    path[length] = '\0';
+    return 0;
+}
+
+/* Expands one word into a new string on the job heap, leaving quoting marks in
+
+word - the word as left by the lexer
+tildeAt - index where a ~ is a home directory, -1 for nowhere
+
+Returns:
+    the word itself if nothing in it can expand
+    the expanded word
+    NULL if the heap is full
+*/
+static char *expand_word(char *word, int tildeAt) {
+    unsigned int length;
+    char *expanded;
+    int special = 0;
+
+    for (unsigned int i = 0; word[i] != '\0'; i++) {
+        special |= EXPANSION_CHAR(word[i]);
+    }
+    if (!special) {
+        return word;
+    }
+    length = expand_text(word, tildeAt, NULL);
+    expanded = alloc(length + 1);
+    if (expanded == NULL) {
+        return NULL;
+    }
+    expand_text(word, tildeAt, expanded);
+    expanded[length] = '\0';
+    return expanded;
+}
+
+/* Expands one word that is not an argument (an assignment or a file name)
+
+word - the word to expand, replaced by its expansion
+tildeAt - index where a ~ is a home directory, -1 for nowhere
+
+Returns:
+    0 if successful
+    -5 if the heap is full
+*/
+static int expand_single(char **word, int tildeAt) {
+    char *expanded = expand_word(*word, tildeAt);
+
+    if (expanded == NULL) {
+        return -5;
+    }
+    strip_marks(expanded);
+    *word = expanded;
+    return 0;
+}
+
+/* Expands the arguments of a command, rebuilding argv on the job heap if
+globbing or dropped words change their number
+
+command - the command
+onlyStage - 1 if the command is the whole job, so it may end up with no arguments
+
+Returns:
+    0 if successful
+    -5 if the heap is full
+*/
+static int expand_arguments(struct Command *command, int onlyStage) {
+    struct GlobMatches words = {NULL, 0, 0};
+    char path[GLOB_PATH_MAX];
+    int reshaped = 0;
+
+    for (unsigned int i = 0; i < command->argc; i++) {
+        command->argv[i] = expand_word(command->argv[i], 0);
+        if (command->argv[i] == NULL) {
+            return -5;
+        }
+        reshaped |= command->argv[i][0] == '\0' || is_pattern(command->argv[i]);
+    }
+    if (!reshaped) {
+        for (unsigned int i = 0; i < command->argc; i++) {
+            strip_marks(command->argv[i]);
+        }
+        return 0;
+    }
+
+    for (unsigned int i = 0; i < command->argc; i++) {
+        char *word = command->argv[i];
+        unsigned int before = words.count;
+
+        // a word with nothing quoted that expanded to nothing is no word at all
+        if (word[0] == '\0') {
+            continue;
+        }
+        if (is_pattern(word)) {
+            path[0] = '\0';
+            if (glob_from(word, path, 0, 0, &words) != 0) {
+                return -5;
+            }
+        }
+        if (words.count == before) {
+            strip_marks(word);
+            if (add_match(&words, word, mystrlen(word)) != 0) {
+                return -5;
+            }
+        }
+    }
+    // a stage of a pipeline can't be empty, so it keeps one empty word
+    if (words.count == 0 && !onlyStage && add_match(&words, "", 0) != 0) {
+        return -5;
+    }
+    if (add_match(&words, "", 0) != 0) {
+        return -5;
+    }
+    words.count -= 1;
+    words.paths[words.count] = NULL;
+    command->argv = words.paths;
+    command->argc = words.count;
+    return 0;
+}
+
+int expand_job(struct Job *job) {
+    for (unsigned int i = 0; i < job->num_stages; i++) {
+        struct Command *command = &job->pipeline[i];
+
+        for (unsigned int j = 0; j < command->num_assignments; j++) {
+            // a ~ straight after the = is a home directory
+            int equals = 0;
+            while (command->assignments[j][equals] != '=') {
+                equals += 1;
+            }
+            if (expand_single(&command->assignments[j], equals + 1) != 0) {
+                return -5;
+            }
+        }
+        if (expand_arguments(command, job->num_stages == 1) != 0) {
+            return -5;
+        }
+        // file names and here-strings are never globbed
+        for (unsigned int j = 0; j < command->num_redirections; j++) {
+            if (command->redirections[j].word != NULL && expand_single(&command->redirections[j].word, 0) != 0) {
+                return -5;
+            }
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,33 @@
+#ifndef EXPAND_H
+#define EXPAND_H
+
+#include "jobs.h"
+
+#define DIR_CACHE_ENTRIES 32        /* directory listings kept for globbing, reused while the directory's mtime is unchanged */
+#define GLOB_PATH_MAX 4096          /* longest path a glob match is built in */
+#define PARAMETER_NAME_MAX 256      /* longest variable name looked up, longer ones expand to nothing */
+
+/* Expands the words of a parsed job in place, after parse_job and before
+the job runs. In every argument, assignment value and redirection:
+  $NAME and ${NAME} become the variable's value (empty if unset), $? the
+  status of the last job, $PIPESTATUS the status of each of its stages
+  separated by spaces, and $$ the shell's pid
+  ~ and ~user at the start of a word (or of an assignment value) become
+  the home directory
+Then arguments holding an unquoted *, ? or [...] are replaced by the
+sorted paths they match, or kept as they are if nothing matches. Values
+of variables are never split or globbed. An argument with nothing quoted
+that expands to nothing is dropped, so a command may be left with no
+arguments (argc 0) when it is the only stage. New words are allocated on
+the job heap. Only the job itself is expanded, not the jobs after it in
+its list, which must see what the jobs before them changed
+
+job - the parsed job, its words still holding the lexer's quoting marks
+
+Returns:
+    0 if successful
+    -5 if the heap could not hold the expanded words
+*/
+int expand_job(struct Job *job);
+
+#endif
@@ -1,22 +1,54 @@
-#ifndef GETJOB_H
-#define GETJOB_H
-
-#include "jobs.h"
-
-/* Prompts user, collects command line into a buffer, then
-tokenizes the command line and fills in supplied job struct
-
-job - the job structure to be populated
-	
-Returns:
-  1 if an exit command is detected
-  0 if run successful and no exit command is detected
-  1 if error due to too many characters
-  -2 if error due to too many arguments
-  -3 if error due to too many pipeline stages
-  -4 if error due to malformed command 
-*/
-int get_job(struct Job* job);
-
-
-#endif
+#ifndef GETJOB_H
+#define GETJOB_H
+
+#include "jobs.h"
+#include "linereader.h"
+
+/* Prompts user, takes the next line from the buffered input reader, then
+parses the command line into the supplied job struct with parse_job, reads
+the bodies of its here-documents and expands its first job
+
+job - the job structure to be populated
+	
+Returns:
+  1 if the end of input is detected
+  0 if run successful
+  -1 if error due to too many characters, or a history event that does not exist
+  -4 if error due to malformed command 
+  -5 if error due to running out of memory
+*/
+int get_job(struct Job* job);
+
+/* Selects where get_job reads command lines from. Child processes are
+reaped while waiting for input, so jobs_init must have been called first
+
+fd - the file descriptor to read from
+showPrompt - 1 to write the prompt before each line, 0 for batch input. With
+             the prompt on and a terminal as fd, lines are read with the line editor
+
+No return values
+*/
+void set_job_input(int fd, int showPrompt);
+
+/* Makes get_job read command lines from a string instead of a file
+descriptor, with the prompt turned off
+
+text - the null terminated command text, may hold several lines
+
+Returns:
+    0 if successful
+    -1 if the text is too long to buffer
+*/
+int set_job_input_string(const char *text);
+
+/* Returns the reader get_job takes command lines from, so a builtin can
+consume the lines that follow it
+
+Takes no arguments
+
+Returns:
+    the shell's input reader
+*/
+struct LineReader *job_input_reader();
+
+#endif
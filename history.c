@@ -0,0 +1,444 @@
+#include "history.h"
+#include "myheap.h"
+#include "mystring.h"
+#include "launch.h"
+#include <unistd.h>
+#include <string.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define HISTORY_BUCKETS 65536      /* index groups, one for each pair of first characters */
+
+/* A line entered in this session */
+struct HistoryLine
+{
+  char *text;               /* followed by the '\n' it was written to the file with */
+  unsigned int length;      /* without the '\n' */
+};
+
+static int enabled = 0;
+static int historyFd = -1;
+static char *mapped = NULL;             /* the file as it was when last mapped */
+static unsigned long mappedSize = 0;
+static struct Arena indexArena;         /* holds offsets and the bucket index, reset when the file is mapped again */
+static unsigned long *offsets = NULL;   /* start of each mapped entry and one past the end, NULL until needed */
+static unsigned long mappedCount = 0;
+static unsigned int *bucketStarts = NULL;   /* where each group starts in bucketEntries, NULL until a search needs it */
+static unsigned int *bucketEntries = NULL;  /* mapped entries grouped by first two characters, in order within a group */
+static struct Arena ringArena;
+static struct HistoryLine ring[HISTORY_RING_ENTRIES];
+static unsigned int ringCount = 0;
+static unsigned long droppedCount = 0;  /* lines of this session lost from a full ring when there is no file */
+
+
+/* Maps the history file as it is now, forgetting the index of the old mapping
+
+Takes no arguments
+No return values
+*/
+static void map_file() {
+    struct stat info;
+    char *address;
+
+    if (mapped != NULL) {
+        munmap(mapped, mappedSize);
+        mapped = NULL;
+        mappedSize = 0;
+    }
+    arena_reset(&indexArena);
+    offsets = NULL;
+    bucketStarts = NULL;
+    bucketEntries = NULL;
+    mappedCount = 0;
+    if (historyFd == -1 || fstat(historyFd, &info) != 0 || info.st_size == 0) {
+        return;
+    }
+    address = mmap(NULL, info.st_size, PROT_READ, MAP_SHARED, historyFd, 0);
+    if (address != MAP_FAILED) {
+        mapped = address;
+        mappedSize = info.st_size;
+    }
+}
+
+/* Maps the file again if it has become shorter than the mapping, which
+another program may do at any time. Touching the mapping past the end of
+the file would raise SIGBUS
+
+Takes no arguments
+No return values
+*/
+static void check_file() {
+    struct stat info;
+
+    if (mapped != NULL && (fstat(historyFd, &info) != 0 || (unsigned long)info.st_size < mappedSize)) {
+        map_file();
+    }
+}
+
+/* Finds where every entry of the mapped file starts, the first time it is
+needed. If there is no memory for it the file's entries are left out
+
+Takes no arguments
+No return values
+*/
+static void index_file() {
+    unsigned long count = 0;
+    char *pos = mapped;
+    char *end = mapped + mappedSize;
+
+    if (offsets != NULL || mapped == NULL) {
+        return;
+    }
+    while ((pos = memchr(pos, '\n', end - pos)) != NULL) {
+        count += 1;
+        pos += 1;
+    }
+    // a last line without its '\n' is an entry too
+    if (mapped[mappedSize - 1] != '\n') {
+        count += 1;
+    }
+    offsets = (unsigned long *)arena_alloc(&indexArena, sizeof(unsigned long) * (count + 1));
+    if (offsets == NULL) {
+        munmap(mapped, mappedSize);
+        mapped = NULL;
+        mappedSize = 0;
+        return;
+    }
+    offsets[0] = 0;
+    pos = mapped;
+    for (unsigned long i = 1; i < count; i++) {
+        pos = memchr(pos, '\n', end - pos) + 1;
+        offsets[i] = pos - mapped;
+    }
+    // as if the last entry ended in '\n', so every length is the gap minus one
+    offsets[count] = mapped[mappedSize - 1] == '\n' ? mappedSize : mappedSize + 1;
+    mappedCount = count;
+}
+
+/* Returns the index group of an entry or prefix, from its first two characters */
+static unsigned int bucket_of(const char *text, unsigned int length) {
+    if (length == 0) {
+        return 0;
+    }
+    return (unsigned char)text[0] << 8 | (length > 1 ? (unsigned char)text[1] : 0);
+}
+
+/* Groups the mapped entries by their first two characters with a counting
+sort, which keeps them in order within each group
+
+Takes no arguments
+
+Returns:
+    0 if successful
+    -1 if there was no memory for the index
+*/
+static int bucket_file() {
+    if (bucketStarts != NULL) {
+        return 0;
+    }
+    bucketStarts = (unsigned int *)arena_alloc(&indexArena, sizeof(unsigned int) * (HISTORY_BUCKETS + 1));
+    bucketEntries = (unsigned int *)arena_alloc(&indexArena, sizeof(unsigned int) * (mappedCount + 1));
+    if (bucketStarts == NULL || bucketEntries == NULL) {
+        bucketStarts = NULL;
+        return -1;
+    }
+    memset(bucketStarts, 0, sizeof(unsigned int) * (HISTORY_BUCKETS + 1));
+    for (unsigned long i = 0; i < mappedCount; i++) {
+        bucketStarts[bucket_of(mapped + offsets[i], offsets[i + 1] - offsets[i] - 1) + 1] += 1;
+    }
+    for (unsigned int i = 1; i <= HISTORY_BUCKETS; i++) {
+        bucketStarts[i] += bucketStarts[i - 1];
+    }
+    // filling moves each start to the end of its group, which is the start of the next
+    for (unsigned long i = 0; i < mappedCount; i++) {
+        bucketEntries[bucketStarts[bucket_of(mapped + offsets[i], offsets[i + 1] - offsets[i] - 1)]++] = i;
+    }
+    for (unsigned int i = HISTORY_BUCKETS; i > 0; i--) {
+        bucketStarts[i] = bucketStarts[i - 1];
+    }
+    bucketStarts[0] = 0;
+    return 0;
+}
+
+int history_open(const char *path) {
+    enabled = 1;
+    historyFd = launch_shell_fd(open(path, O_RDWR | O_CREAT | O_APPEND | O_CLOEXEC, 0600));
+    if (historyFd == -1) {
+        return -1;
+    }
+    map_file();
+    return 0;
+}
+
+int history_enabled() {
+    return enabled;
+}
+
+int history_add(const char *line, unsigned int length) {
+    unsigned int blank = 1;
+    char *copy;
+
+    if (length > 0 && line[length - 1] == '\n') {
+        length -= 1;
+    }
+    for (unsigned int i = 0; i < length; i++) {
+        blank &= line[i] == ' ' || line[i] == '\t';
+    }
+    if (blank) {
+        return 0;
+    }
+    if (ringCount == HISTORY_RING_ENTRIES) {
+        // the file already holds every line of the ring, so mapping it again takes them over
+        if (historyFd != -1) {
+            map_file();
+        } else {
+            droppedCount += ringCount;
+        }
+        ringCount = 0;
+        arena_reset(&ringArena);
+    }
+    copy = arena_alloc(&ringArena, length + 1);
+    if (copy == NULL) {
+        return -1;
+    }
+    memcpy(copy, line, length);
+    copy[length] = '\n';
+    ring[ringCount].text = copy;
+    ring[ringCount].length = length;
+    ringCount += 1;
+    if (historyFd != -1) {
+        // one write, so lines of shells sharing the file never interleave
+        write(historyFd, copy, length + 1);
+    }
+    return 0;
+}
+
+/* Returns the number of the latest entry without checking the file, for
+loops that must keep one mapping throughout
+
+Takes no arguments
+
+Returns:
+    the same values as history_count
+*/
+static unsigned long entry_count() {
+    index_file();
+    return mappedCount + droppedCount + ringCount;
+}
+
+/* Looks up an entry without checking the file
+
+Arguments and return values are those of history_get
+*/
+static int get_entry(unsigned long number, const char **text) {
+    unsigned long count = entry_count();
+
+    if (number == 0 || number > count) {
+        return -1;
+    }
+    if (number <= mappedCount) {
+        *text = mapped + offsets[number - 1];
+        return offsets[number] - offsets[number - 1] - 1;
+    }
+    if (number <= mappedCount + droppedCount) {
+        return -1;
+    }
+    number -= mappedCount + droppedCount + 1;
+    *text = ring[number].text;
+    return ring[number].length;
+}
+
+unsigned long history_count() {
+    check_file();
+    return entry_count();
+}
+
+int history_get(unsigned long number, const char **text) {
+    check_file();
+    return get_entry(number, text);
+}
+
+/* Reads the event after a !: another ! for the last entry, n for entry n
+or -n for the nth last entry
+
+text - the characters after the !
+number - set to the entry number, 0 if it is out of range
+
+Returns:
+    the number of characters of text that were part of the event
+    0 if there is no event, so the ! is an ordinary character
+*/
+static int event_number(const char *text, unsigned long *number) {
+    unsigned long value = 0;
+    int relative = text[0] == '-';
+    int used = relative;
+
+    if (text[0] == '!') {
+        *number = history_count();
+        return 1;
+    }
+    while (text[used] >= '0' && text[used] <= '9') {
+        // more digits than any history can number only make the event missing
+        if (value < 1000000000000L) {
+            value = value * 10 + (text[used] - '0');
+        }
+        used += 1;
+    }
+    if (used == relative) {
+        return 0;
+    }
+    *number = value;
+    if (relative) {
+        *number = value <= history_count() ? history_count() + 1 - value : 0;
+    }
+    return used;
+}
+
+/* Copies a line with its events replaced by their entries
+
+line - the line, ending in '\n'
+length - the number of characters in the line
+dest - where the result goes, NULL to only measure it
+found - set to 1 if the line held an event
+
+Returns:
+    the length of the result
+    -1 if an entry does not exist
+*/
+static int expand_events(const char *line, int length, char *dest, int *found) {
+    int singleQuoted = 0;
+    int doubleQuoted = 0;
+    int pos = 0;
+    unsigned long number;
+    const char *text;
+    int used;
+    int entryLength;
+
+    *found = 0;
+    for (int i = 0; i < length; i++) {
+        char c = line[i];
+
+        if (c == '\\' && !singleQuoted && i + 1 < length) {
+            if (dest != NULL) {
+                dest[pos] = c;
+                dest[pos + 1] = line[i + 1];
+            }
+            pos += 2;
+            i += 1;
+            continue;
+        }
+        if (c == '\'' && !doubleQuoted) {
+            singleQuoted = !singleQuoted;
+        } else if (c == '"' && !singleQuoted) {
+            doubleQuoted = !doubleQuoted;
+        } else if (c == '!' && !singleQuoted && (used = event_number(line + i + 1, &number)) > 0) {
+            entryLength = history_get(number, &text);
+            if (entryLength < 0) {
+                return -1;
+            }
+            if (dest != NULL) {
+                memcpy(dest + pos, text, entryLength);
+            }
+            pos += entryLength;
+            i += used;
+            *found = 1;
+            continue;
+        }
+        if (dest != NULL) {
+            dest[pos] = c;
+        }
+        pos += 1;
+    }
+    return pos;
+}
+
+int history_expand(char *line, int length, char **expanded) {
+    int found;
+    int newLength = expand_events(line, length, NULL, &found);
+
+    *expanded = line;
+    if (newLength < 0 || !found) {
+        return newLength < 0 ? -1 : length;
+    }
+    *expanded = alloc(newLength);
+    if (*expanded == NULL) {
+        return -5;
+    }
+    expand_events(line, length, *expanded, &found);
+    return newLength;
+}
+
+/* Adds one numbered entry to the output, writing the block out when full
+
+out - the file descriptor written to
+block - the output gathered so far, HISTORY_PRINT_BUFFER characters
+pos - the number of characters in block, updated
+number - the entry number
+text - the entry
+length - the number of characters in the entry
+
+No return values
+*/
+static void write_entry(int out, char *block, unsigned int *pos, unsigned long number, const char *text, unsigned int length) {
+    char digits[20];
+    unsigned int numberLength = myitoa(number, digits);
+
+    if (*pos + length + 28 > HISTORY_PRINT_BUFFER) {
+        write(out, block, *pos);
+        *pos = 0;
+    }
+    // numbers right aligned in five columns, then two spaces
+    for (unsigned int i = numberLength; i < 5; i++) {
+        block[(*pos)++] = ' ';
+    }
+    memcpy(block + *pos, digits, numberLength);
+    memcpy(block + *pos + numberLength, "  ", 2);
+    *pos += numberLength + 2;
+    if (length + 1 > HISTORY_PRINT_BUFFER - *pos) {
+        // an entry too long for the block goes out on its own
+        write(out, block, *pos);
+        write(out, text, length);
+        block[0] = '\n';
+        *pos = 1;
+        return;
+    }
+    memcpy(block + *pos, text, length);
+    block[*pos + length] = '\n';
+    *pos += length + 1;
+}
+
+void print_history(int out, const char *prefix) {
+    char block[HISTORY_PRINT_BUFFER];
+    unsigned int prefixLength = mystrlen(prefix);
+    unsigned int pos = 0;
+    const char *text;
+    // checked once here, so the mapping and its index stay the same for the whole listing
+    unsigned long total = history_count();
+    unsigned long first = 0;
+    unsigned long last = mappedCount;
+    int length;
+
+    // a prefix of two or more characters only needs to look at its group
+    if (prefixLength >= 2 && bucket_file() == 0) {
+        first = bucketStarts[bucket_of(prefix, prefixLength)];
+        last = bucketStarts[bucket_of(prefix, prefixLength) + 1];
+    }
+    for (unsigned long i = first; i < last; i++) {
+        unsigned long number = (prefixLength >= 2 && bucketStarts != NULL ? bucketEntries[i] : i) + 1;
+
+        length = get_entry(number, &text);
+        if (length >= (int)prefixLength && memcmp(text, prefix, prefixLength) == 0) {
+            write_entry(out, block, &pos, number, text, length);
+        }
+    }
+    for (unsigned long number = mappedCount + droppedCount + 1; number <= total; number++) {
+        length = get_entry(number, &text);
+        if (length >= (int)prefixLength && memcmp(text, prefix, prefixLength) == 0) {
+            write_entry(out, block, &pos, number, text, length);
+        }
+    }
+    if (pos > 0) {
+        write(out, block, pos);
+    }
+}
@@ -0,0 +1,94 @@
+#ifndef HISTORY_H
+#define HISTORY_H
+
+#define HISTORY_RING_ENTRIES 4096      /* lines of this session held in memory before the file is mapped again */
+#define HISTORY_FILE_NAME ".mysh_history"  /* in $HOME, unless MYSH_HISTFILE names another file */
+#define HISTORY_PRINT_BUFFER 65536     /* bytes gathered by print_history before each write */
+
+/* Command history of an interactive shell. Earlier sessions are read from an
+append-only file that is mmap'd rather than parsed, so opening it costs the
+same however long it is; the line offsets are only found the first time a
+number or a search needs them. Lines of this session are appended to the
+file as they are entered and kept in a ring, and once the ring fills the
+file is mapped again to take them over. Entries are numbered from 1 */
+
+/* Opens the history file, creating it if needed, and turns history on.
+History still works for the session if the file can't be opened
+
+path - the history file
+
+Returns:
+    0 if successful
+    -1 if the file could not be opened
+*/
+int history_open(const char *path);
+
+/* Reports whether history is on
+
+Takes no arguments
+
+Returns:
+    1 if history_open has been called
+    0 if not
+*/
+int history_enabled();
+
+/* Records a line, writing it to the file at once. Blank lines are skipped
+
+line - the line, need not be null terminated
+length - the number of characters in the line, a trailing '\n' is dropped
+
+Returns:
+    0 if successful
+    -1 if the line could not be stored
+*/
+int history_add(const char *line, unsigned int length);
+
+/* Returns the number of the latest entry
+
+Takes no arguments
+
+Returns:
+    the number of entries, 0 if there are none
+*/
+unsigned long history_count();
+
+/* Looks up an entry
+
+number - the entry number, from 1 to history_count()
+text - set to the start of the entry, not null terminated
+
+Returns:
+    the length of the entry
+    -1 if there is no such entry
+*/
+int history_get(unsigned long number, const char **text);
+
+/* Replaces !! (the last entry), !n (entry n) and !-n (the nth last entry)
+in a command line, except inside '...' or after a \. An expanded line is
+allocated on the job heap
+
+line - the line read, ending in '\n'
+length - the number of characters in the line
+expanded - set to the resulting line, which is line itself if nothing was replaced
+
+Returns:
+    the length of the resulting line
+    -1 if an entry does not exist
+    -5 if the heap could not hold the expanded line
+*/
+int history_expand(char *line, int length, char **expanded);
+
+/* Writes the entries that start with a prefix, oldest first, each with its
+number. Entries from the file are found through an index grouping them by
+their first two characters, so a search reads only the entries that share
+them
+
+out - the file descriptor to write to
+prefix - the null terminated prefix, "" for every entry
+
+No return values
+*/
+void print_history(int out, const char *prefix);
+
+#endif
@@ -1,22 +1,56 @@
 #ifndef JOBS_H
 #define JOBS_H
 
-#define MAX_ARGS 64  
-#define MAX_PIPELINE_LEN 64
+/* Commands and their argument lists are allocated from the job heap,
+sized to the parsed line, and are only valid until the next get_job */
+
+#define REDIRECT_INPUT  0   /* n<file, n is 0 if not given */
+#define REDIRECT_OUTPUT 1   /* n>file, truncating the file, n is 1 if not given */
+#define REDIRECT_APPEND 2   /* n>>file */
+#define REDIRECT_DUP    3   /* n>&m or n<&m, n becomes a copy of m */
+#define REDIRECT_STRING 4   /* n<<<word, n reads the word and a newline */
+#define REDIRECT_HEREDOC 5  /* n<<word, n reads the lines after the command up to one that is just word */
+
+#define REDIRECT_MOST_FD 9  /* highest fd a redirection may name */
+
+/* One redirection of a command. A command's redirections are applied in
+the order they were written, after the pipes of its pipeline, so a later
+one may use the fd an earlier one set up (>out 2>&1) */
+struct Redirection
+{
+  int type;                 /* one of the REDIRECT_ values */
+  int fd;                   /* the fd the command sees */
+  char *word;               /* the file name, here-string or here-document (its delimiter until get_job reads it), NULL for REDIRECT_DUP */
+  int source;               /* the fd REDIRECT_DUP copies */
+};
 
 struct Command
 {
-  char *argv[MAX_ARGS+1];
-  unsigned int argc;
+  char **argv;              /* NULL terminated, argc entries before the NULL */
+  unsigned int argc;        /* 0 for a command made only of assignments */
+  char **assignments;       /* leading NAME=value words, not NULL terminated */
+  unsigned int num_assignments;
+  struct Redirection *redirections;     /* in the order written */
+  unsigned int num_redirections;
 };
 
+#define JOB_THEN 0          /* ; & or the end of the line: the next job always runs */
+#define JOB_AND  1          /* &&: the next job runs if the status so far is 0 */
+#define JOB_OR   2          /* ||: the next job runs if the status so far is not 0 */
+
+/* One pipeline. A command line is a list of them, linked through next in
+the order written, each saying how the one after it is chosen. A job that
+is skipped leaves the status as it was, so a && b || c runs c when a fails.
+An and-or list ended by & is run as a single background job */
 struct Job
 {
-  struct Command pipeline[MAX_PIPELINE_LEN];
+  struct Command *pipeline;	/* num_stages commands */
   unsigned int num_stages;
-  char *outfile_path;		/* NULL for no output redirection */
-  char *infile_path;		/* NULL for no input redirection */
-  int background;			/* 0 for foreground, 1 for background */
+  int background;			/* 0 for foreground, 1 for background (every job of an and-or list ended by &) */
+  int timed;				/* 1 if the line started with the time keyword */
+  unsigned int here_documents;	/* REDIRECT_HEREDOC redirections still holding their delimiter */
+  struct Job *next;			/* the next job of the line, NULL for the last */
+  int next_if;				/* JOB_THEN, JOB_AND or JOB_OR */
 };
 
 #endif
@@ -0,0 +1,778 @@
+#define _GNU_SOURCE
+#include "jobtable.h"
+#include "mystring.h"
+#include "launch.h"
+#include "trace.h"
+#include <unistd.h>
+#include <signal.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <poll.h>
+#include <string.h>
+#include <termios.h>
+#include <sys/wait.h>
+#include <sys/resource.h>
+
+const char *jobTableError = "Error: too many jobs running\n";
+const char *jobMemoryError = "Error: out of memory for job\n";
+const char *doneMessage = "Done";
+const char *stoppedMessage = "Stopped";
+const char *runningMessage = "Running";
+
+static struct JobEntry jobTable[JOB_TABLE_SIZE];
+static int eventPipe[2] = {-1, -1};
+static int notifyJobs = 0;
+static int jobControl = 0;
+static pid_t shellPgid = 0;
+static struct termios shellModes;     /* terminal settings restored whenever the shell takes the terminal back */
+static struct JobResult lastResult;
+static struct Arena resultArena;       /* holds the arrays of lastResult */
+static int singleStatus;               /* the statuses array of a result from set_job_result */
+
+
+/* Writes a byte to the event pipe so the main loop wakes up. Only async
+signal safe calls are made, and errno is preserved for the interrupted code
+
+sig - the signal number (SIGCHLD)
+
+No return values
+*/
+static void sigchld_handler(int sig) {
+    int savedErrno = errno;
+    char byte = 0;
+
+    // the pipe is non-blocking, a full pipe already means "events pending"
+    write(eventPipe[1], &byte, 1);
+    errno = savedErrno;
+}
+
+/* Puts the shell in its own process group in the foreground of the terminal,
+and ignores the signals the terminal sends to the foreground group. Children
+get these signals back through launch_command
+
+Takes no arguments
+
+Returns:
+    0 if the shell owns the terminal
+    -1 if job control can't be used
+*/
+static int take_control() {
+    pid_t owner;
+
+    // started in the background of another shell: wait until we are foregrounded
+    while ((owner = tcgetpgrp(LAUNCH_TERMINAL)) != getpgrp()) {
+        if (owner == -1) {
+            return -1;
+        }
+        kill(-getpgrp(), SIGTTIN);
+    }
+
+    signal(SIGINT, SIG_IGN);
+    signal(SIGQUIT, SIG_IGN);
+    signal(SIGTSTP, SIG_IGN);
+    signal(SIGTTIN, SIG_IGN);
+    signal(SIGTTOU, SIG_IGN);
+
+    shellPgid = getpid();
+    // fails harmlessly when the shell already leads a session
+    setpgid(0, shellPgid);
+    shellPgid = getpgrp();
+    if (tcsetpgrp(LAUNCH_TERMINAL, shellPgid) == -1) {
+        return -1;
+    }
+    tcgetattr(LAUNCH_TERMINAL, &shellModes);
+    return 0;
+}
+
+int jobs_init(int interactive) {
+    struct sigaction action;
+
+    notifyJobs = interactive;
+    if (pipe2(eventPipe, O_CLOEXEC | O_NONBLOCK) == -1) {
+        return -1;
+    }
+    eventPipe[0] = launch_shell_fd(eventPipe[0]);
+    eventPipe[1] = launch_shell_fd(eventPipe[1]);
+    if (eventPipe[0] == -1 || eventPipe[1] == -1) {
+        return -1;
+    }
+
+    // without SA_NOCLDSTOP stopped and continued children wake the shell too
+    action.sa_handler = sigchld_handler;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = SA_RESTART;
+    sigaction(SIGCHLD, &action, NULL);
+
+    set_job_result(0);
+    if (interactive && take_control() == 0) {
+        jobControl = 1;
+    }
+    return 0;
+}
+
+int job_control_enabled() {
+    return jobControl;
+}
+
+int job_event_fd() {
+    return eventPipe[0];
+}
+
+/* Turns a status from waitpid into a shell exit status
+
+status - the status filled in by waitpid
+
+Returns:
+    the exit code if the program exited normally
+    128 plus the signal number if the program was killed by a signal
+*/
+static int decode_status(int status) {
+    if (WIFSIGNALED(status)) {
+        return 128 + WTERMSIG(status);
+    }
+    return WEXITSTATUS(status);
+}
+
+/* Returns a table entry to the free state
+
+entry - the entry to free
+
+No return values
+*/
+static void free_job(struct JobEntry *entry) {
+    arena_reset(&entry->arena);
+    entry->state = JOB_FREE;
+    entry->id = 0;
+}
+
+void jobs_init_child() {
+    for (int i = 0; i < JOB_TABLE_SIZE; i++) {
+        if (jobTable[i].state != JOB_FREE) {
+            free_job(&jobTable[i]);
+        }
+    }
+    close(eventPipe[0]);
+    close(eventPipe[1]);
+    pipe2(eventPipe, O_CLOEXEC | O_NONBLOCK);
+    eventPipe[0] = launch_shell_fd(eventPipe[0]);
+    eventPipe[1] = launch_shell_fd(eventPipe[1]);
+    notifyJobs = 0;
+    jobControl = 0;
+}
+
+/* Writes a line such as "[2] Done  sleep 5"
+
+out - file descriptor to write to
+entry - the job to report on
+word - the text after the job number
+
+No return values
+*/
+static void report_job(int out, struct JobEntry *entry, const char *word) {
+    char number[20];
+
+    write(out, "[", 1);
+    write(out, number, myitoa(entry->id, number));
+    write(out, "] ", 2);
+    write(out, word, mystrlen(word));
+    write(out, "  ", 2);
+    write(out, entry->command, mystrlen(entry->command));
+    write(out, "\n", 1);
+}
+
+/* Marks a job stopped, remembering its terminal settings and the signal
+so both can be restored when it is continued
+
+entry - the job one of whose stages stopped
+status - the status filled in by waitpid
+
+Returns:
+    1 if a background job stopped and was reported
+    0 otherwise
+*/
+static int record_stop(struct JobEntry *entry, int status) {
+    if (entry->state == JOB_STOPPED) {
+        return 0;
+    }
+    entry->state = JOB_STOPPED;
+    entry->stop_signal = WSTOPSIG(status);
+    if (entry->foreground) {
+        tcgetattr(LAUNCH_TERMINAL, &entry->modes);
+        entry->has_modes = 1;
+    }
+    // a foreground stop is reported by wait_for_job once it has the terminal back
+    if (entry->background && notifyJobs) {
+        report_job(1, entry, stoppedMessage);
+        return 1;
+    }
+    return 0;
+}
+
+/* Records a change of state of a reaped process in the table
+
+pid - the process that changed state
+status - the status filled in by wait4
+usage - the resources the process used, filled in by wait4
+
+Returns:
+    1 if a background job finished or stopped and was reported
+    0 otherwise
+*/
+static int record_exit(pid_t pid, int status, struct rusage *usage) {
+    for (int i = 0; i < JOB_TABLE_SIZE; i++) {
+        struct JobEntry *entry = &jobTable[i];
+        if (entry->state != JOB_RUNNING && entry->state != JOB_STOPPED) {
+            continue;
+        }
+        for (unsigned int j = 0; j < entry->num_pids; j++) {
+            if (entry->pids[j] != pid) {
+                continue;
+            }
+            if (WIFSTOPPED(status)) {
+                return record_stop(entry, status);
+            }
+            if (WIFCONTINUED(status)) {
+                entry->state = JOB_RUNNING;
+                return 0;
+            }
+            entry->statuses[j] = decode_status(status);
+            // the folded status can't tell a program that exited with 130 from one Ctrl-C killed
+            entry->interrupted |= WIFSIGNALED(status) && WTERMSIG(status) == SIGINT;
+            clock_gettime(CLOCK_MONOTONIC, &entry->usage[j].finished);
+            entry->usage[j].user = usage->ru_utime;
+            entry->usage[j].system = usage->ru_stime;
+            entry->usage[j].max_rss = usage->ru_maxrss;
+            entry->usage[j].switches = usage->ru_nvcsw + usage->ru_nivcsw;
+            entry->remaining -= 1;
+            if (entry->remaining == 0) {
+                entry->state = JOB_DONE;
+                clock_gettime(CLOCK_MONOTONIC, &entry->finished);
+                entry->exit_status = entry->statuses[entry->num_pids - 1];
+                // nobody waits for a background job, so report and free it here
+                if (entry->background) {
+                    if (notifyJobs) {
+                        report_job(1, entry, doneMessage);
+                    }
+                    free_job(entry);
+                    return notifyJobs;
+                }
+            }
+            return 0;
+        }
+    }
+    return 0;
+}
+
+int handle_job_events() {
+    char drain[64];
+    struct rusage usage;
+    int status;
+    int reports = 0;
+    pid_t pid;
+
+    while (read(eventPipe[0], drain, sizeof(drain)) > 0) {}
+
+    while ((pid = wait4(-1, &status, WNOHANG | WUNTRACED | WCONTINUED, &usage)) > 0) {
+        TRACE_INSTANT(TRACE_REAP, pid);
+        reports += record_exit(pid, status, &usage);
+    }
+    return reports;
+}
+
+int wait_for_job_event() {
+    struct pollfd watch = {eventPipe[0], POLLIN, 0};
+
+    // the handler writes after every change, so no SIGCHLD can be missed
+    if (poll(&watch, 1, -1) == -1 && errno != EINTR) {
+        return -1;
+    }
+    return handle_job_events();
+}
+
+/* Appends a string to the command text being built for an entry
+
+dest - where to write
+pos - the offset to write at, advanced past the text
+text - the text to append
+
+No return values
+*/
+static void append_text(char *dest, unsigned int *pos, const char *text) {
+    while (*text != '\0') {
+        dest[*pos] = *text;
+        *pos += 1;
+        text += 1;
+    }
+}
+
+/* Appends the jobs after the first of an and-or list run with &, which are
+all part of one entry, as "&& cmd" or "|| cmd"
+
+dest - where to write
+pos - the offset to write at, advanced past the text
+job - the first job of the list
+
+No return values
+*/
+static void append_list(char *dest, unsigned int *pos, struct Job *job) {
+    for (; job->background && job->next_if != JOB_THEN; job = job->next) {
+        append_text(dest, pos, job->next_if == JOB_AND ? " && " : " || ");
+        for (unsigned int i = 0; i < job->next->num_stages; i++) {
+            if (i > 0) {
+                append_text(dest, pos, " | ");
+            }
+            for (unsigned int j = 0; j < job->next->pipeline[i].argc; j++) {
+                if (j > 0) {
+                    append_text(dest, pos, " ");
+                }
+                append_text(dest, pos, job->next->pipeline[i].argv[j]);
+            }
+        }
+    }
+}
+
+struct JobEntry *create_job(struct Job *job) {
+    struct JobEntry *entry = NULL;
+    unsigned long textLength = 2;
+    unsigned int pos = 0;
+    int nextId = 1;
+
+    // reuse the lowest free slot and give it one more than the highest id in use
+    for (int i = 0; i < JOB_TABLE_SIZE; i++) {
+        if (jobTable[i].state == JOB_FREE) {
+            if (entry == NULL) {
+                entry = &jobTable[i];
+            }
+        } else if (jobTable[i].id >= nextId) {
+            nextId = jobTable[i].id + 1;
+        }
+    }
+    if (entry == NULL) {
+        write(1, jobTableError, 29);
+        return NULL;
+    }
+
+    for (struct Job *part = job; part != NULL; part = part->background && part->next_if != JOB_THEN ? part->next : NULL) {
+        textLength += 4;
+        for (unsigned int i = 0; i < part->num_stages; i++) {
+            for (unsigned int j = 0; j < part->pipeline[i].argc; j++) {
+                textLength += mystrlen(part->pipeline[i].argv[j]) + 3;
+            }
+        }
+    }
+    entry->pids = (pid_t *)arena_alloc(&entry->arena, sizeof(pid_t) * job->num_stages);
+    entry->statuses = (int *)arena_alloc(&entry->arena, sizeof(int) * job->num_stages);
+    entry->usage = (struct StageUsage *)arena_alloc(&entry->arena, sizeof(struct StageUsage) * job->num_stages);
+    entry->command = arena_alloc(&entry->arena, textLength);
+    if (entry->pids == NULL || entry->statuses == NULL || entry->usage == NULL || entry->command == NULL) {
+        arena_reset(&entry->arena);
+        write(1, jobMemoryError, 29);
+        return NULL;
+    }
+
+    // rebuild the command line, joining words with spaces and stages with " | "
+    for (unsigned int i = 0; i < job->num_stages; i++) {
+        struct StageUsage *usage = &entry->usage[i];
+
+        if (i > 0) {
+            append_text(entry->command, &pos, " | ");
+        }
+        *usage = (struct StageUsage){0};
+        usage->text = entry->command + pos;
+        for (unsigned int j = 0; j < job->pipeline[i].argc; j++) {
+            if (j > 0) {
+                append_text(entry->command, &pos, " ");
+            }
+            append_text(entry->command, &pos, job->pipeline[i].argv[j]);
+        }
+        usage->text_length = entry->command + pos - usage->text;
+    }
+    append_list(entry->command, &pos, job);
+    if (job->background) {
+        append_text(entry->command, &pos, " &");
+    }
+    entry->command[pos] = '\0';
+
+    entry->id = nextId;
+    entry->state = JOB_RUNNING;
+    entry->background = 0;
+    entry->foreground = 0;
+    entry->pgid = 0;
+    entry->stop_signal = 0;
+    entry->has_modes = 0;
+    entry->num_pids = 0;
+    entry->max_pids = job->num_stages;
+    entry->remaining = 0;
+    entry->exit_status = 0;
+    entry->interrupted = 0;
+    clock_gettime(CLOCK_MONOTONIC, &entry->started);
+    entry->finished = entry->started;
+    return entry;
+}
+
+void job_add_process(struct JobEntry *entry, pid_t pid) {
+    clock_gettime(CLOCK_MONOTONIC, &entry->usage[entry->num_pids].started);
+    entry->usage[entry->num_pids].finished = entry->usage[entry->num_pids].started;
+    entry->pids[entry->num_pids] = pid;
+    if (pid == 0) {
+        entry->statuses[entry->num_pids] = EXIT_NOT_EXECUTED;
+    } else {
+        entry->remaining += 1;
+        // the first stage that started leads the job's process group
+        if (jobControl && entry->pgid == 0) {
+            entry->pgid = pid;
+        }
+    }
+    entry->num_pids += 1;
+}
+
+void job_set_status(struct JobEntry *entry, unsigned int stage, int status) {
+    entry->statuses[stage] = status;
+}
+
+/* Marks a job finished if it has no stages left to reap
+
+entry - the job to check
+
+No return values
+*/
+static void check_job_done(struct JobEntry *entry) {
+    if (entry->remaining == 0 && entry->state != JOB_DONE) {
+        entry->state = JOB_DONE;
+        clock_gettime(CLOCK_MONOTONIC, &entry->finished);
+        entry->exit_status = entry->num_pids > 0 ? entry->statuses[entry->num_pids - 1] : 0;
+    }
+}
+
+void set_job_result(int status) {
+    singleStatus = status;
+    lastResult.num_stages = 1;
+    lastResult.statuses = &singleStatus;
+    lastResult.usage = NULL;
+    lastResult.interrupted = 0;
+    clock_gettime(CLOCK_MONOTONIC, &lastResult.finished);
+    lastResult.started = lastResult.finished;
+}
+
+const struct JobResult *last_job_result() {
+    return &lastResult;
+}
+
+/* Copies the statuses and usage of a finished job into the last job result
+
+entry - the finished job
+
+No return values
+*/
+static void save_result(struct JobEntry *entry) {
+    char *text;
+
+    arena_reset(&resultArena);
+    lastResult.num_stages = entry->num_pids;
+    lastResult.statuses = (int *)arena_alloc(&resultArena, sizeof(int) * entry->num_pids + 1);
+    lastResult.usage = (struct StageUsage *)arena_alloc(&resultArena, sizeof(struct StageUsage) * entry->num_pids + 1);
+    text = arena_alloc(&resultArena, mystrlen(entry->command) + 1);
+    lastResult.started = entry->started;
+    lastResult.finished = entry->finished;
+    if (lastResult.statuses == NULL || lastResult.usage == NULL || text == NULL) {
+        set_job_result(entry->exit_status);
+        lastResult.interrupted = entry->interrupted;
+        return;
+    }
+    lastResult.interrupted = entry->interrupted;
+    memcpy(text, entry->command, mystrlen(entry->command) + 1);
+    for (unsigned int i = 0; i < entry->num_pids; i++) {
+        lastResult.statuses[i] = entry->statuses[i];
+        lastResult.usage[i] = entry->usage[i];
+        // the text goes with the entry, so point into the copy instead
+        lastResult.usage[i].text = text + (entry->usage[i].text - entry->command);
+    }
+}
+
+/* Formats a duration as seconds with three decimals, e.g. "1.204"
+
+text - where the characters are written, with room for at least 24
+millis - the duration in milliseconds
+
+Returns:
+    the number of characters written
+*/
+static int format_seconds(char *text, long millis) {
+    int pos = myitoa(millis / 1000, text);
+
+    text[pos++] = '.';
+    text[pos++] = '0' + millis / 100 % 10;
+    text[pos++] = '0' + millis / 10 % 10;
+    text[pos++] = '0' + millis % 10;
+    return pos;
+}
+
+/* Writes one row of a usage table, e.g. "2\t0\t1.204\t0.950\t0.012\t3140\t17\tgrep x"
+
+out - file descriptor to write to
+label - the first column, a stage number or "total"
+status - exit status of the stage or job
+real - wall time in milliseconds
+user - user CPU time in milliseconds
+system - system CPU time in milliseconds
+maxRss - peak resident set in kilobytes
+switches - context switches
+command - the command text
+length - the number of characters of command to write
+
+No return values
+*/
+static void write_usage_row(int out, const char *label, int status, long real, long user, long system,
+                            long maxRss, long switches, const char *command, int length) {
+    char text[160];
+    int pos = mystrlen(label);
+
+    memcpy(text, label, pos);
+    text[pos++] = '\t';
+    pos += myitoa(status, text + pos);
+    text[pos++] = '\t';
+    pos += format_seconds(text + pos, real);
+    text[pos++] = '\t';
+    pos += format_seconds(text + pos, user);
+    text[pos++] = '\t';
+    pos += format_seconds(text + pos, system);
+    text[pos++] = '\t';
+    pos += myitoa(maxRss, text + pos);
+    text[pos++] = '\t';
+    pos += myitoa(switches, text + pos);
+    text[pos++] = '\t';
+    write(out, text, pos);
+    write(out, command, length);
+    write(out, "\n", 1);
+}
+
+/* Measures the time between two CLOCK_MONOTONIC readings
+
+from - the earlier time
+to - the later time
+
+Returns:
+    the milliseconds between them
+*/
+static long elapsed_millis(const struct timespec *from, const struct timespec *to) {
+    return (to->tv_sec - from->tv_sec) * 1000 + (to->tv_nsec - from->tv_nsec) / 1000000;
+}
+
+/* Converts a CPU time reported by wait4
+
+time - the time to convert
+
+Returns:
+    the time in milliseconds
+*/
+static long timeval_millis(const struct timeval *time) {
+    return time->tv_sec * 1000 + time->tv_usec / 1000;
+}
+
+void print_job_usage(int out, const struct JobResult *result) {
+    const char *header = "stage\tstatus\treal\tuser\tsys\tmaxrss_kb\tswitches\tcommand\n";
+    long user = 0;
+    long system = 0;
+    long maxRss = 0;
+    long switches = 0;
+    char label[20];
+
+    if (result->usage == NULL) {
+        return;
+    }
+    write(out, header, mystrlen(header));
+    for (unsigned int i = 0; i < result->num_stages; i++) {
+        const struct StageUsage *usage = &result->usage[i];
+
+        label[myitoa(i + 1, label)] = '\0';
+        write_usage_row(out, label, result->statuses[i], elapsed_millis(&usage->started, &usage->finished),
+                        timeval_millis(&usage->user), timeval_millis(&usage->system),
+                        usage->max_rss, usage->switches, usage->text, usage->text_length);
+        user += timeval_millis(&usage->user);
+        system += timeval_millis(&usage->system);
+        switches += usage->switches;
+        if (usage->max_rss > maxRss) {
+            maxRss = usage->max_rss;
+        }
+    }
+    // CPU and switches add up across stages, but they share memory only at the peak
+    write_usage_row(out, "total", result->statuses[result->num_stages - 1],
+                    elapsed_millis(&result->started, &result->finished),
+                    user, system, maxRss, switches, "", 0);
+}
+
+/* Gives the terminal back to the shell after a foreground job finished or
+stopped, with the settings it had before the job started
+
+Takes no arguments
+No return values
+*/
+static void restore_terminal() {
+    tcsetpgrp(LAUNCH_TERMINAL, shellPgid);
+    tcsetattr(LAUNCH_TERMINAL, TCSADRAIN, &shellModes);
+}
+
+int wait_for_job(struct JobEntry *entry) {
+    int owned = entry->foreground;
+    long traceStart = TRACE_START();
+    int status;
+
+    check_job_done(entry);
+    while (entry->state == JOB_RUNNING) {
+        if (wait_for_job_event() == -1) {
+            break;
+        }
+    }
+    TRACE_SPAN(TRACE_WAIT, traceStart, entry->id);
+    if (owned) {
+        entry->foreground = 0;
+        restore_terminal();
+    }
+
+    if (entry->state == JOB_STOPPED) {
+        // nobody waits for it now, it stays in the table until fg, bg or its exit
+        entry->background = 1;
+        if (notifyJobs) {
+            write(1, "\n", 1);
+            report_job(1, entry, stoppedMessage);
+        }
+        set_job_result(128 + entry->stop_signal);
+        return 128 + entry->stop_signal;
+    }
+    save_result(entry);
+    status = entry->exit_status;
+    if (owned && notifyJobs && status == 128 + SIGINT) {
+        // the ^C echoed by the terminal leaves the cursor mid line
+        write(1, "\n", 1);
+    }
+    free_job(entry);
+    return status;
+}
+
+void foreground_job(struct JobEntry *entry) {
+    entry->background = 0;
+    entry->foreground = jobControl;
+}
+
+int continue_job(struct JobEntry *entry, int foreground) {
+    if (!jobControl || entry->pgid == 0) {
+        return -1;
+    }
+    if (foreground) {
+        foreground_job(entry);
+        tcsetpgrp(LAUNCH_TERMINAL, entry->pgid);
+        if (entry->has_modes) {
+            tcsetattr(LAUNCH_TERMINAL, TCSADRAIN, &entry->modes);
+        }
+    } else {
+        entry->background = 1;
+    }
+    if (entry->state == JOB_STOPPED) {
+        // marked running now, a later stop is noticed through WUNTRACED
+        entry->state = JOB_RUNNING;
+        kill(-entry->pgid, SIGCONT);
+    }
+    return 0;
+}
+
+struct JobEntry *find_job(const char *spec) {
+    struct JobEntry *found = NULL;
+    int id = 0;
+
+    if (spec != NULL && spec[0] == '%') {
+        spec += 1;
+    }
+    // no spec, %% and %+ mean the current job: the newest stopped job, else the newest job
+    if (spec == NULL || spec[0] == '\0' || mystrcmp(spec, "%") == 0 || mystrcmp(spec, "+") == 0) {
+        for (int i = 0; i < JOB_TABLE_SIZE; i++) {
+            struct JobEntry *entry = &jobTable[i];
+            if (entry->state == JOB_FREE || entry->state == JOB_DONE) {
+                continue;
+            }
+            if (found == NULL
+                || (entry->state == JOB_STOPPED) > (found->state == JOB_STOPPED)
+                || ((entry->state == JOB_STOPPED) == (found->state == JOB_STOPPED) && entry->id > found->id)) {
+                found = entry;
+            }
+        }
+        return found;
+    }
+
+    for (; *spec != '\0'; spec++) {
+        if (*spec < '0' || *spec > '9' || id > JOB_TABLE_SIZE * 1000) {
+            return NULL;
+        }
+        id = id * 10 + (*spec - '0');
+    }
+    for (int i = 0; i < JOB_TABLE_SIZE; i++) {
+        if (jobTable[i].id == id && (jobTable[i].state == JOB_RUNNING || jobTable[i].state == JOB_STOPPED)) {
+            return &jobTable[i];
+        }
+    }
+    return NULL;
+}
+
+int print_jobs(int out) {
+    int count = 0;
+
+    // ids are not in slot order once slots are reused
+    for (int id = 1, left = 1; left; id++) {
+        left = 0;
+        for (int i = 0; i < JOB_TABLE_SIZE; i++) {
+            struct JobEntry *entry = &jobTable[i];
+            if (entry->state == JOB_RUNNING || entry->state == JOB_STOPPED) {
+                if (entry->id > id) {
+                    left = 1;
+                } else if (entry->id == id) {
+                    report_job(out, entry, entry->state == JOB_STOPPED ? stoppedMessage : runningMessage);
+                    count += 1;
+                }
+            }
+        }
+    }
+    return count;
+}
+
+int wait_for_background() {
+    int running = 1;
+
+    while (running) {
+        handle_job_events();
+        // stopped jobs would never finish, so they are not waited for
+        running = 0;
+        for (int i = 0; i < JOB_TABLE_SIZE; i++) {
+            if (jobTable[i].state == JOB_RUNNING && jobTable[i].background) {
+                running = 1;
+            }
+        }
+        if (running && wait_for_job_event() == -1) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void background_job(struct JobEntry *entry) {
+    char number[20];
+    pid_t lastPid = 0;
+
+    entry->background = 1;
+    check_job_done(entry);
+    if (entry->state == JOB_DONE) {
+        free_job(entry);
+        return;
+    }
+    // like other shells, show the pid of the last stage that started
+    for (unsigned int i = 0; i < entry->num_pids; i++) {
+        if (entry->pids[i] != 0) {
+            lastPid = entry->pids[i];
+        }
+    }
+    if (notifyJobs) {
+        write(1, "[", 1);
+        write(1, number, myitoa(entry->id, number));
+        write(1, "] ", 2);
+        write(1, number, myitoa(lastPid, number));
+        write(1, "\n", 1);
+    }
+}
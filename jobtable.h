@@ -0,0 +1,264 @@
+#ifndef JOBTABLE_H
+#define JOBTABLE_H
+
+#include "jobs.h"
+#include "myheap.h"
+#include <sys/types.h>
+#include <termios.h>
+#include <time.h>
+#include <sys/time.h>
+
+#define JOB_TABLE_SIZE 256      /* most jobs that can be running at once */
+
+#define JOB_FREE    0           /* slot not in use */
+#define JOB_RUNNING 1           /* at least one stage has not been reaped */
+#define JOB_DONE    2           /* every stage has been reaped */
+#define JOB_STOPPED 3           /* a stage was stopped, by Ctrl-Z or by touching the terminal */
+
+#define EXIT_NOT_EXECUTED 127   /* status of a stage whose program could not be executed */
+
+/* Resources used by one stage of a job, filled in when it is reaped by wait4 */
+struct StageUsage
+{
+  const char *text;         /* the stage's words, within the job's command text */
+  unsigned int text_length;
+  struct timespec started;  /* CLOCK_MONOTONIC time the stage was started */
+  struct timespec finished; /* CLOCK_MONOTONIC time the stage was reaped */
+  struct timeval user;      /* user CPU time */
+  struct timeval system;    /* system CPU time */
+  long max_rss;             /* largest resident set, in kilobytes */
+  long switches;            /* voluntary plus involuntary context switches */
+};
+
+/* Outcome of the most recent job the shell waited for, kept after its
+table entry is freed for $? and $PIPESTATUS and for time reports */
+struct JobResult
+{
+  unsigned int num_stages;
+  int *statuses;            /* exit status of each stage */
+  struct StageUsage *usage; /* resources of each stage, NULL if not measured */
+  struct timespec started;  /* when the job was created */
+  struct timespec finished; /* when its last stage was reaped */
+  int interrupted;          /* 1 if a stage was killed by SIGINT, as Ctrl-C does */
+};
+
+/* A started job and the state of each of its processes. Children are reaped
+by handle_job_events whenever SIGCHLD has written to the event pipe. Under job
+control every job runs in its own process group, led by its first started stage */
+struct JobEntry
+{
+  int id;                   /* number shown to the user, 1 and up */
+  int state;                /* JOB_FREE, JOB_RUNNING, JOB_DONE or JOB_STOPPED */
+  int background;           /* 1 once the shell has stopped waiting for the job */
+  int foreground;           /* 1 while the job's group owns the terminal */
+  pid_t pgid;               /* process group of the job, 0 without job control */
+  int stop_signal;          /* signal that last stopped the job */
+  int has_modes;            /* 1 if modes holds the terminal settings of a stopped job */
+  struct termios modes;     /* terminal settings the job had when it stopped */
+  pid_t *pids;              /* one per stage, 0 for a stage that never started */
+  int *statuses;            /* decoded exit status of each stage once reaped */
+  struct StageUsage *usage; /* resources of each stage once reaped */
+  unsigned int num_pids;    /* stages recorded so far */
+  unsigned int max_pids;    /* room in pids and statuses */
+  unsigned int remaining;   /* recorded stages not yet reaped */
+  int exit_status;          /* status of the last stage */
+  int interrupted;          /* 1 if a stage was killed by SIGINT */
+  struct timespec started;  /* CLOCK_MONOTONIC time the entry was created */
+  struct timespec finished; /* CLOCK_MONOTONIC time the last stage was reaped */
+  char *command;            /* the command line, rebuilt from the job for reports */
+  struct Arena arena;       /* holds pids, statuses, usage and command */
+};
+
+/* Creates the event pipe and installs the SIGCHLD handler that writes to it.
+An interactive shell also takes its terminal for job control
+
+interactive - 1 to report background jobs as they start, stop and finish, and
+              to run jobs in their own process groups
+
+Returns:
+    0 if successful
+    -1 if the pipe could not be created
+*/
+int jobs_init(int interactive);
+
+/* Tells whether jobs run in their own process groups with terminal handoff
+
+Takes no arguments
+
+Returns:
+    1 if job control is on
+    0 if not (batch input, or no usable terminal)
+*/
+int job_control_enabled();
+
+/* Returns the read end of the event pipe, readable whenever a child has changed state
+
+Takes no arguments
+
+Returns:
+    the file descriptor to watch
+*/
+int job_event_fd();
+
+/* Drains the event pipe and reaps every child that has finished, stopped or
+continued with wait4, updating the job table and each stage's resource usage. Finished background jobs are reported
+(if enabled) and freed
+
+Takes no arguments
+
+Returns:
+    the number of reports written
+*/
+int handle_job_events();
+
+/* Blocks until at least one child has changed state, then handles the events
+as handle_job_events does. A signal arriving while blocked also ends the wait
+
+Takes no arguments
+
+Returns:
+    the number of reports written
+    -1 if the event pipe could not be polled
+*/
+int wait_for_job_event();
+
+/* Forgets the shell's jobs in a forked child that goes on running shell code
+(a builtin in a pipeline), and gives it its own event pipe so it can't take
+the shell's wakeups. Job control and reports are turned off in the child
+
+Takes no arguments
+No return values
+*/
+void jobs_init_child();
+
+/* Reserves a table entry for a job about to be started
+
+job - the job that will be started, used to size the entry and describe it
+
+Returns:
+    the new entry
+    NULL if the table is full or out of memory (error already printed)
+*/
+struct JobEntry *create_job(struct Job *job);
+
+/* Records a started stage of a job
+
+entry - the job the stage belongs to
+pid - the pid of the stage, or 0 if its program could not be executed
+
+No return values
+*/
+void job_add_process(struct JobEntry *entry, pid_t pid);
+
+/* Sets the exit status of a stage the shell ran itself, which was recorded
+with job_add_process as pid 0
+
+entry - the job the stage belongs to
+stage - the index of the stage in the job
+status - the exit status of the stage
+
+No return values
+*/
+void job_set_status(struct JobEntry *entry, unsigned int stage, int status);
+
+/* Waits, blocking on the event pipe, until every recorded stage of a job has
+been reaped, then saves its statuses and usage as the last job result and
+frees the entry. If the job stops instead it is reported and left in the
+table in the background. The terminal is given back to the shell if the job
+had it
+
+entry - the job to wait for
+
+Returns:
+    the exit status of the job's last stage
+    128 plus the signal number if the job stopped
+*/
+int wait_for_job(struct JobEntry *entry);
+
+/* Replaces the last job result with a single stage that used no measured
+resources, for jobs the shell did not wait for (builtins, background jobs, errors)
+
+status - the exit status to record
+
+No return values
+*/
+void set_job_result(int status);
+
+/* Returns the outcome of the most recent job
+
+Takes no arguments
+
+Returns:
+    the last job result, valid until the next job finishes
+*/
+const struct JobResult *last_job_result();
+
+/* Writes a table of the wall time, CPU time, peak memory and context switches
+of each stage of a result, followed by the totals for the job
+
+out - file descriptor to write to
+result - the result to report on, as returned by last_job_result
+
+No return values
+*/
+void print_job_usage(int out, const struct JobResult *result);
+
+/* Marks a job as the one the shell is about to wait for. Under job control
+its stages are started (or continued) as owners of the terminal
+
+entry - the job to move to the foreground
+
+No return values
+*/
+void foreground_job(struct JobEntry *entry);
+
+/* Continues a job, sending SIGCONT to its process group if it is stopped
+
+entry - the job to continue
+foreground - 1 to give it the terminal (wait_for_job takes it back), 0 to leave it in the background
+
+Returns:
+    0 if successful
+    -1 if job control is off or the job has no process group
+*/
+int continue_job(struct JobEntry *entry, int foreground);
+
+/* Looks up a running or stopped job from a job spec
+
+spec - "%n" or "n" for job n, "%%", "%+", "" or NULL for the current job
+
+Returns:
+    the entry of the job
+    NULL if there is no such job
+*/
+struct JobEntry *find_job(const char *spec);
+
+/* Lists running and stopped jobs in id order, one "[n] Running  cmd" line each
+
+out - file descriptor to write to
+
+Returns:
+    the number of jobs listed
+*/
+int print_jobs(int out);
+
+/* Waits until no background job is running. Stopped jobs are not waited for
+
+Takes no arguments
+
+Returns:
+    0 if successful
+    -1 if the event pipe could not be polled
+*/
+int wait_for_background();
+
+/* Lets a job run on without the shell waiting for it. It is reported and
+freed once all of its stages have been reaped
+
+entry - the job to put in the background
+
+No return values
+*/
+void background_job(struct JobEntry *entry);
+
+#endif
@@ -0,0 +1,518 @@
+#define _GNU_SOURCE
+#include "launch.h"
+#include "mystring.h"
+#include "trace.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <spawn.h>
+#include <errno.h>
+#include <signal.h>
+#include <dirent.h>
+#include <string.h>
+#include <sched.h>
+#include <sys/socket.h>
+#include <sys/stat.h>
+
+const char *forkError = "Error occurred while forking new process\n";
+const char *execveError = "Error occurred while executing program\n";
+
+static int launchMode = LAUNCH_FORK;
+static int zygoteSocket = -1;       /* the shell's end of the zygote's socket, -1 if it is not running */
+
+/* The fixed part of a zygote request. It is followed by the path, the
+arguments and then the environment, each null terminated. The shell's
+working directory is always the last fd sent along */
+struct ZygoteRequest
+{
+  mode_t umask;             /* the shell's file creation mask */
+  int job_control;
+  pid_t pgid;
+  int foreground;
+  unsigned int num_moves;
+  struct FdMove moves[ZYGOTE_MOST_MOVES];   /* a negative source is -1 minus the index of an fd sent along */
+  unsigned int num_args;
+  unsigned int num_env;
+};
+
+static char requestBuffer[ZYGOTE_MESSAGE_MAX];
+
+/* Signals the shell may ignore (SIGPIPE always, the rest when interactive), put back to their defaults in children */
+static const int shellSignals[] = {SIGINT, SIGQUIT, SIGTSTP, SIGTTIN, SIGTTOU, SIGPIPE};
+
+
+static int start_zygote();
+
+void set_launch_mode(int mode) {
+    if (mode == LAUNCH_ZYGOTE && zygoteSocket == -1 && start_zygote() != 0) {
+        mode = LAUNCH_FORK;
+    }
+    launchMode = mode;
+}
+
+int get_launch_mode() {
+    return launchMode;
+}
+
+int launch_mode_from_name(const char *name) {
+    if (name != NULL && mystrcmp(name, "spawn") == 0) {
+        return LAUNCH_SPAWN;
+    }
+    if (name != NULL && mystrcmp(name, "zygote") == 0) {
+        return LAUNCH_ZYGOTE;
+    }
+    return LAUNCH_FORK;
+}
+
+/*
+Closes every descriptor marked close-on-exec, as execve would have, so a
+function run in a forked child does not hold pipe ends open (runs in child process)
+
+Takes no arguments
+No return values
+*/
+static void close_exec_fds() {
+    DIR *dir = opendir("/proc/self/fd");
+    struct dirent *entry;
+    long fd;
+
+    if (dir == NULL) {
+        return;
+    }
+    while ((entry = readdir(dir)) != NULL) {
+        if (myatoi(entry->d_name, &fd) != 0 || fd <= 2 || fd == dirfd(dir)) {
+            continue;
+        }
+        if (fcntl(fd, F_GETFD) & FD_CLOEXEC) {
+            close(fd);
+        }
+    }
+    closedir(dir);
+}
+
+/*
+Applies the fd moves of a launch and executes its program, or calls its function (runs in child process)
+
+launch - the program and fd moves to use
+
+Returns:
+    void (exits child process via execve or _exit)
+*/
+static void run_command_no_fork(struct Launch *launch) {
+    if (launch->job_control) {
+        // the parent does the same, whichever runs first creates the group
+        setpgid(0, launch->pgid);
+        if (launch->foreground) {
+            // SIGTTOU is still ignored here, so a non-foreground group may take the terminal
+            tcsetpgrp(LAUNCH_TERMINAL, getpgrp());
+        }
+    }
+    for (unsigned int i = 0; i < sizeof(shellSignals) / sizeof(shellSignals[0]); i++) {
+        signal(shellSignals[i], SIG_DFL);
+    }
+    for (unsigned int i = 0; i < launch->num_moves; i++) {
+        if (launch->moves[i].source == launch->moves[i].target) {
+            // dup2 onto itself is a no-op, so drop close-on-exec by hand
+            fcntl(launch->moves[i].target, F_SETFD, 0);
+        } else {
+            dup2(launch->moves[i].source, launch->moves[i].target);
+        }
+    }
+    if (launch->function != NULL) {
+        // children of the zygote become the shell's, so a forked builtin launches on its own
+        if (launchMode == LAUNCH_ZYGOTE) {
+            launchMode = LAUNCH_SPAWN;
+        }
+        close_exec_fds();
+        _exit(launch->function(launch->argc, launch->argv, 0, 1));
+    }
+    if (traceEnabled) {
+        trace_exec(launch->path);
+    }
+    execve(launch->path, launch->argv, launch->envp);
+    write(1, execveError, 39);
+    _exit(127);
+}
+
+/*
+Starts a program with fork, copying the shell's page tables
+
+launch - the program, arguments, environment and fd moves to use
+
+Returns:
+    the pid of the child if successful
+    -1 if error while forking
+*/
+static pid_t fork_launch(struct Launch *launch) {
+    pid_t pid = fork();
+
+    if (pid == -1) {
+        write(1, forkError, 41);
+        return -1;
+    }
+    if (pid == 0) {
+        run_command_no_fork(launch);
+    }
+    if (launch->job_control) {
+        setpgid(pid, launch->pgid != 0 ? launch->pgid : pid);
+    }
+    return pid;
+}
+
+/*
+Starts a program with posix_spawn. glibc implements this with
+clone(CLONE_VM | CLONE_VFORK), so the cost does not grow with the shell's memory
+
+launch - the program, arguments, environment and fd moves to use
+
+Returns:
+    the pid of the child if successful
+    0 if the program could not be executed
+    -1 if no process could be created
+*/
+static pid_t spawn_launch(struct Launch *launch) {
+    posix_spawn_file_actions_t actions;
+    posix_spawnattr_t attributes;
+    sigset_t defaults;
+    short flags = POSIX_SPAWN_SETSIGDEF;
+    pid_t pid;
+    int error;
+
+    sigemptyset(&defaults);
+    for (unsigned int i = 0; i < sizeof(shellSignals) / sizeof(shellSignals[0]); i++) {
+        sigaddset(&defaults, shellSignals[i]);
+    }
+    posix_spawnattr_init(&attributes);
+    posix_spawnattr_setsigdefault(&attributes, &defaults);
+
+    posix_spawn_file_actions_init(&actions);
+    if (launch->job_control) {
+        flags |= POSIX_SPAWN_SETPGROUP;
+        posix_spawnattr_setpgroup(&attributes, launch->pgid);
+#if __GLIBC_PREREQ(2, 35)
+        // runs in the child with signals blocked, before fd 0 is replaced
+        if (launch->foreground) {
+            posix_spawn_file_actions_addtcsetpgrp_np(&actions, LAUNCH_TERMINAL);
+        }
+#endif
+    }
+    posix_spawnattr_setflags(&attributes, flags);
+    for (unsigned int i = 0; i < launch->num_moves; i++) {
+        // glibc clears close-on-exec when source and target are the same fd
+        posix_spawn_file_actions_adddup2(&actions, launch->moves[i].source, launch->moves[i].target);
+    }
+
+    error = posix_spawn(&pid, launch->path, &actions, &attributes, launch->argv, launch->envp);
+    posix_spawn_file_actions_destroy(&actions);
+    posix_spawnattr_destroy(&attributes);
+
+    if (error == 0) {
+        if (launch->job_control) {
+            setpgid(pid, launch->pgid != 0 ? launch->pgid : pid);
+        }
+        return pid;
+    }
+    // Resource errors mean no process was made, anything else is the exec failing
+    if (error == EAGAIN || error == ENOMEM) {
+        write(1, forkError, 41);
+        return -1;
+    }
+    write(1, execveError, 39);
+    return 0;
+}
+
+/*
+Runs a launch received by the zygote (runs in the zygote's clone child)
+
+arg - the struct Launch to run
+
+Returns:
+    never (exits via execve or _exit)
+*/
+static int zygote_child(void *arg) {
+    run_command_no_fork((struct Launch *)arg);
+    return 127;
+}
+
+/*
+Serves launch requests until the shell closes its end of the socket. Each
+child is cloned with CLONE_PARENT, so it is the shell's child: the shell
+gets its SIGCHLD, reaps it with wait4 and can set its process group, just
+as if it had forked it (runs in the zygote process)
+
+sock - the zygote's end of the socket
+
+Returns:
+    void (exits the zygote with _exit)
+*/
+static void zygote_main(int sock) {
+    static char buffer[ZYGOTE_MESSAGE_MAX];
+    static char *pointers[ZYGOTE_MESSAGE_MAX / 2 + 2];
+    static char stack[ZYGOTE_STACK_SIZE];
+    char control[CMSG_SPACE(sizeof(int) * (ZYGOTE_MOST_MOVES + 1))];
+    struct ZygoteRequest *request = (struct ZygoteRequest *)buffer;
+    struct iovec iov = {buffer, sizeof(buffer)};
+    struct msghdr message;
+    struct cmsghdr *header;
+    struct Launch launch;
+    int fds[ZYGOTE_MOST_MOVES + 1];
+    unsigned int numFds;
+    ssize_t length;
+    pid_t pid;
+
+    while (1) {
+        memset(&message, 0, sizeof(message));
+        message.msg_iov = &iov;
+        message.msg_iovlen = 1;
+        message.msg_control = control;
+        message.msg_controllen = sizeof(control);
+        length = recvmsg(sock, &message, MSG_CMSG_CLOEXEC);
+        if (length == -1 && errno == EINTR) {
+            continue;
+        }
+        if (length <= 0) {
+            _exit(0);
+        }
+
+        numFds = 0;
+        header = CMSG_FIRSTHDR(&message);
+        if (header != NULL && header->cmsg_level == SOL_SOCKET && header->cmsg_type == SCM_RIGHTS) {
+            numFds = (header->cmsg_len - CMSG_LEN(0)) / sizeof(int);
+            memcpy(fds, CMSG_DATA(header), sizeof(int) * numFds);
+        }
+
+        pid = -1;
+        // the child starts where the shell is now, not where it was when the zygote was forked
+        if ((size_t)length >= sizeof(*request) && !(message.msg_flags & (MSG_TRUNC | MSG_CTRUNC))
+                && numFds > 0 && fchdir(fds[numFds - 1]) == 0) {
+            // the strings were written back to back, so pointers can be laid over them in order
+            char *text = buffer + sizeof(*request);
+            unsigned int count = request->num_args + request->num_env;
+
+            launch.path = text;
+            text += mystrlen(text) + 1;
+            for (unsigned int i = 0; i <= count; i++) {
+                if (i == request->num_args) {
+                    pointers[i] = NULL;
+                    continue;
+                }
+                pointers[i] = text;
+                text += mystrlen(text) + 1;
+            }
+            pointers[count + 1] = NULL;
+            launch.argv = pointers;
+            launch.envp = pointers + request->num_args + 1;
+            for (unsigned int i = 0; i < request->num_moves; i++) {
+                if (request->moves[i].source < 0) {
+                    request->moves[i].source = fds[-1 - request->moves[i].source];
+                }
+            }
+            launch.moves = request->moves;
+            launch.num_moves = request->num_moves;
+            launch.job_control = request->job_control;
+            launch.pgid = request->pgid;
+            launch.foreground = request->foreground;
+            launch.function = NULL;
+            umask(request->umask);
+            pid = clone(zygote_child, stack + sizeof(stack), CLONE_PARENT | SIGCHLD, &launch);
+        }
+        for (unsigned int i = 0; i < numFds; i++) {
+            close(fds[i]);
+        }
+        send(sock, &pid, sizeof(pid), MSG_NOSIGNAL);
+    }
+}
+
+/*
+Forks the zygote, which keeps the few pages the shell has at this point
+however large the shell grows later
+
+Takes no arguments
+
+Returns:
+    0 if successful
+    -1 if the zygote could not be started
+*/
+static int start_zygote() {
+    int pair[2];
+    pid_t pid;
+
+    if (socketpair(AF_UNIX, SOCK_SEQPACKET | SOCK_CLOEXEC, 0, pair) == -1) {
+        return -1;
+    }
+    pair[0] = launch_shell_fd(pair[0]);
+    pair[1] = launch_shell_fd(pair[1]);
+    if (pair[0] == -1 || pair[1] == -1) {
+        close(pair[0]);
+        close(pair[1]);
+        return -1;
+    }
+    pid = fork();
+    if (pid == -1) {
+        close(pair[0]);
+        close(pair[1]);
+        return -1;
+    }
+    if (pid == 0) {
+        close(pair[0]);
+        // it never has children of its own, and only its children's exec events are traced
+        signal(SIGCHLD, SIG_DFL);
+        if (traceEnabled) {
+            trace_child();
+        }
+        zygote_main(pair[1]);
+    }
+    close(pair[1]);
+    zygoteSocket = pair[0];
+    return 0;
+}
+
+/*
+Stops using a zygote that can no longer be reached, falling back to fork
+
+Takes no arguments
+No return values
+*/
+static void lose_zygote() {
+    close(zygoteSocket);
+    zygoteSocket = -1;
+    launchMode = LAUNCH_FORK;
+}
+
+/*
+Starts a program by asking the zygote to create it. Pipe ends and files the
+program is to use are sent along with SCM_RIGHTS; fds 0 to 2 and targets of
+earlier moves are named by number, as they are the same in the zygote.
+The working directory goes along as an O_PATH fd, and the umask by value,
+since cd changes them in the shell after the zygote was forked
+
+launch - the program, arguments, environment and fd moves to use
+
+Returns:
+    the pid of the child if successful
+    -1 if no process could be created
+*/
+static pid_t zygote_launch(struct Launch *launch) {
+    struct ZygoteRequest *request = (struct ZygoteRequest *)requestBuffer;
+    char control[CMSG_SPACE(sizeof(int) * (ZYGOTE_MOST_MOVES + 1))];
+    int fds[ZYGOTE_MOST_MOVES + 1];
+    unsigned int numFds = 0;
+    unsigned int pos = sizeof(*request);
+    struct iovec iov;
+    struct msghdr message;
+    struct cmsghdr *header;
+    unsigned int numArgs = 0;
+    unsigned int numEnv = 0;
+    ssize_t length;
+    pid_t pid;
+
+    if (launch->num_moves > ZYGOTE_MOST_MOVES) {
+        return fork_launch(launch);
+    }
+    while (launch->argv[numArgs] != NULL) {
+        numArgs += 1;
+    }
+    while (launch->envp[numEnv] != NULL) {
+        numEnv += 1;
+    }
+    // the path, then every argument and variable, measured as they are copied
+    for (unsigned int i = 0; i <= numArgs + numEnv; i++) {
+        const char *text = i == 0 ? launch->path : i <= numArgs ? launch->argv[i - 1] : launch->envp[i - 1 - numArgs];
+        unsigned int size = mystrlen(text) + 1;
+
+        if (pos + size > ZYGOTE_MESSAGE_MAX) {
+            return fork_launch(launch);
+        }
+        memcpy(requestBuffer + pos, text, size);
+        pos += size;
+    }
+
+    request->umask = umask(0);
+    umask(request->umask);
+    request->job_control = launch->job_control;
+    request->pgid = launch->pgid;
+    request->foreground = launch->foreground;
+    request->num_moves = launch->num_moves;
+    request->num_args = numArgs;
+    request->num_env = numEnv;
+    for (unsigned int i = 0; i < launch->num_moves; i++) {
+        int source = launch->moves[i].source;
+        int earlierTarget = 0;
+
+        for (unsigned int j = 0; j < i; j++) {
+            earlierTarget |= launch->moves[j].target == source;
+        }
+        request->moves[i] = launch->moves[i];
+        if (source > 2 && !earlierTarget) {
+            fds[numFds] = source;
+            request->moves[i].source = -1 - (int)numFds;
+            numFds += 1;
+        }
+    }
+
+    fds[numFds] = open(".", O_PATH | O_DIRECTORY | O_CLOEXEC);
+    if (fds[numFds] == -1) {
+        return fork_launch(launch);
+    }
+    numFds += 1;
+
+    iov.iov_base = requestBuffer;
+    iov.iov_len = pos;
+    memset(&message, 0, sizeof(message));
+    message.msg_iov = &iov;
+    message.msg_iovlen = 1;
+    message.msg_control = control;
+    message.msg_controllen = CMSG_SPACE(sizeof(int) * numFds);
+    header = CMSG_FIRSTHDR(&message);
+    header->cmsg_level = SOL_SOCKET;
+    header->cmsg_type = SCM_RIGHTS;
+    header->cmsg_len = CMSG_LEN(sizeof(int) * numFds);
+    memcpy(CMSG_DATA(header), fds, sizeof(int) * numFds);
+    while ((length = sendmsg(zygoteSocket, &message, MSG_NOSIGNAL)) == -1 && errno == EINTR) {
+    }
+    close(fds[numFds - 1]);
+    if (length == -1) {
+        lose_zygote();
+        return fork_launch(launch);
+    }
+    while ((length = recv(zygoteSocket, &pid, sizeof(pid), 0)) == -1 && errno == EINTR) {
+    }
+    if (length != sizeof(pid)) {
+        lose_zygote();
+        write(1, forkError, 41);
+        return -1;
+    }
+    if (pid == -1) {
+        write(1, forkError, 41);
+        return -1;
+    }
+    if (launch->job_control) {
+        setpgid(pid, launch->pgid != 0 ? launch->pgid : pid);
+    }
+    return pid;
+}
+
+pid_t launch_command(struct Launch *launch) {
+    long traceStart = TRACE_START();
+    pid_t pid;
+
+    if (launchMode == LAUNCH_SPAWN && launch->function == NULL) {
+        pid = spawn_launch(launch);
+    } else if (launchMode == LAUNCH_ZYGOTE && launch->function == NULL) {
+        pid = zygote_launch(launch);
+    } else {
+        pid = fork_launch(launch);
+    }
+    TRACE_SPAN(TRACE_LAUNCH, traceStart, pid);
+    return pid;
+}
+
+int launch_shell_fd(int fd) {
+    int moved;
+
+    if (fd == -1 || fd >= LAUNCH_SHELL_FD) {
+        return fd;
+    }
+    moved = fcntl(fd, F_DUPFD_CLOEXEC, LAUNCH_SHELL_FD);
+    close(fd);
+    return moved;
+}
@@ -0,0 +1,99 @@
+#ifndef LAUNCH_H
+#define LAUNCH_H
+
+#include <sys/types.h>
+
+#define LAUNCH_FORK  0     /* fork() then apply fd moves and execve in the child */
+#define LAUNCH_SPAWN 1     /* posix_spawn() with file actions, no page table copy */
+#define LAUNCH_ZYGOTE 2    /* a small helper forked at startup creates the process as the shell's child */
+
+#define ZYGOTE_MESSAGE_MAX 65536   /* largest launch request sent to the zygote, bigger ones are forked directly */
+#define ZYGOTE_MOST_MOVES 8        /* most fd moves a zygote launch may carry */
+#define ZYGOTE_STACK_SIZE 65536    /* stack of the zygote's clone child before it execs */
+
+#define LAUNCH_TERMINAL 0  /* fd of the controlling terminal when job control is on */
+#define LAUNCH_SHELL_FD 10 /* lowest fd the shell keeps for itself, above any a redirection may name */
+
+/* A single dup2 to perform in the new process before it execs.
+Moves are applied in order, so a later move may use an earlier target as its source */
+struct FdMove
+{
+  int target;       /* fd number the program will see */
+  int source;       /* fd to duplicate onto target */
+};
+
+/* Everything needed to start one program, independent of how it is started.
+All fds opened by the shell are close-on-exec, so nothing needs closing explicitly.
+Signals the shell ignores are always set back to their defaults in the new process.
+A launch with a function forks and calls it with fds 0 and 1, without exec */
+struct Launch
+{
+  char *path;               /* path handed to execve */
+  char **argv;              /* NULL terminated argument list */
+  char **envp;              /* NULL terminated environment */
+  struct FdMove *moves;     /* dup2 operations to perform, in order */
+  unsigned int num_moves;
+  int job_control;          /* 1 to place the process in the process group pgid */
+  pid_t pgid;               /* group to join, 0 to lead a new group named after the process */
+  int foreground;           /* 1 to hand the terminal to the group (job control only) */
+  int (*function)(int argc, char **argv, int in, int out);    /* run in place of path if not NULL */
+  int argc;                 /* argument count handed to function */
+};
+
+/* Selects how launch_command starts new processes. The first time
+LAUNCH_ZYGOTE is selected the zygote is forked, so this is best done early,
+while the shell is still small. If it can't be started LAUNCH_FORK is used
+
+mode - LAUNCH_FORK, LAUNCH_SPAWN or LAUNCH_ZYGOTE
+
+No return values
+*/
+void set_launch_mode(int mode);
+
+/* Returns the mode currently used by launch_command
+
+Takes no arguments
+
+Returns:
+    LAUNCH_FORK, LAUNCH_SPAWN or LAUNCH_ZYGOTE
+*/
+int get_launch_mode();
+
+/* Converts the name of a launch mode into its constant
+
+name - "fork", "spawn" or "zygote", may be NULL
+
+Returns:
+    LAUNCH_SPAWN if name is "spawn"
+    LAUNCH_ZYGOTE if name is "zygote"
+    LAUNCH_FORK for anything else, including NULL
+*/
+int launch_mode_from_name(const char *name);
+
+/* Starts the described program in a new process using the current launch mode
+(always fork for a function, which needs the shell's memory, and for a launch
+too big for a zygote request).
+With job_control set the process group is also set from the shell's side, so
+it exists as soon as this returns
+
+launch - the program, arguments, environment and fd moves to use
+
+Returns:
+    the pid of the new process if successful
+    0 if the process could not exec the program (spawn mode only, error already printed)
+    -1 if no process could be created (error already printed)
+*/
+pid_t launch_command(struct Launch *launch);
+
+/* Moves one of the shell's own fds to LAUNCH_SHELL_FD or above, so that
+redirections such as 3>&4 can never reach it. The fd stays close-on-exec
+
+fd - the fd to move, may be -1
+
+Returns:
+    the fd to use in its place (fd itself if it was already high enough)
+    -1 if fd was -1 or could not be moved (fd is closed)
+*/
+int launch_shell_fd(int fd);
+
+#endif
@@ -0,0 +1,651 @@
+#define _GNU_SOURCE
+#include "lineedit.h"
+#include "history.h"
+#include "complete.h"
+#include "mystring.h"
+#include <unistd.h>
+#include <string.h>
+#include <errno.h>
+#include <poll.h>
+#include <termios.h>
+#include <sys/ioctl.h>
+
+#define KEY_CTRL(c) ((c) & 0x1f)
+#define KEY_ESCAPE 27
+#define KEY_BACKSPACE 127
+#define KEY_UP 1000             /* keys that arrive as escape sequences, past any byte value */
+#define KEY_DOWN 1001
+#define KEY_LEFT 1002
+#define KEY_RIGHT 1003
+#define KEY_HOME 1004
+#define KEY_END 1005
+#define KEY_DELETE 1006
+
+#define SEARCH_PROMPT "(reverse-i-search)`"
+#define FAILED_SEARCH_PROMPT "(failed reverse-i-search)`"
+
+/* The line being edited and where the keys come from */
+struct EditState
+{
+  int fd;
+  const char *prompt;
+  unsigned int prompt_length;
+  int event_fd;
+  void (*event_handler)();
+  char text[EDIT_LINE_MAX + 1];     /* room for the '\n' added when the line is done */
+  unsigned int length;
+  unsigned int cursor;
+  char draft[EDIT_LINE_MAX];        /* the new line, kept while the history is shown */
+  unsigned int draft_length;
+  unsigned long history_index;      /* entry shown, one past the last for the new line */
+  unsigned long history_last;
+};
+
+static struct EditState state;
+static char input[EDIT_INPUT_SIZE];
+static unsigned int inputStart = 0;
+static unsigned int inputEnd = 0;
+static char screen[EDIT_LINE_MAX + EDIT_QUERY_MAX + 128];
+
+
+/* Returns the number of terminal columns a piece of text takes, counting
+each UTF-8 character once */
+static unsigned int columns(const char *text, unsigned int length) {
+    unsigned int count = 0;
+
+    for (unsigned int i = 0; i < length; i++) {
+        count += ((unsigned char)text[i] & 0xc0) != 0x80;
+    }
+    return count;
+}
+
+/* Returns the width of the terminal, 80 if it can't be found */
+static unsigned int terminal_width() {
+    struct winsize size;
+
+    if (ioctl(1, TIOCGWINSZ, &size) == -1 || size.ws_col == 0) {
+        return 80;
+    }
+    return size.ws_col;
+}
+
+/* Draws a prompt and text on the current row, scrolling the text sideways
+so the cursor stays on screen, and leaves the cursor in place
+
+prompt - the prompt
+promptLength - the number of characters in the prompt
+text - the text after the prompt
+length - the number of characters in text
+cursor - the position of the cursor in text
+
+No return values
+*/
+static void draw(const char *prompt, unsigned int promptLength, const char *text, unsigned int length, unsigned int cursor) {
+    unsigned int width = terminal_width();
+    unsigned int promptColumns = columns(prompt, promptLength);
+    unsigned int start = 0;
+    unsigned int end = cursor;
+    unsigned int pos = 0;
+    unsigned int column;
+    char digits[12];
+    int digitCount;
+
+    // drop characters from the left until the cursor fits, then add from the right until the row is full
+    column = promptColumns + columns(text, cursor);
+    while (start < cursor && column >= width) {
+        start += 1;
+        while (start < cursor && ((unsigned char)text[start] & 0xc0) == 0x80) {
+            start += 1;
+        }
+        column -= 1;
+    }
+    for (unsigned int used = column; end < length && used + 1 < width; used++) {
+        end += 1;
+        while (end < length && ((unsigned char)text[end] & 0xc0) == 0x80) {
+            end += 1;
+        }
+    }
+
+    screen[pos++] = '\r';
+    memcpy(screen + pos, prompt, promptLength);
+    pos += promptLength;
+    memcpy(screen + pos, text + start, end - start);
+    pos += end - start;
+    // clear the rest of the row, go back to its start and forward to the cursor
+    memcpy(screen + pos, "\x1b[0K\r", 5);
+    pos += 5;
+    if (column > 0) {
+        screen[pos++] = '\x1b';
+        screen[pos++] = '[';
+        digitCount = 0;
+        do {
+            digits[digitCount++] = '0' + column % 10;
+            column /= 10;
+        } while (column > 0);
+        while (digitCount > 0) {
+            screen[pos++] = digits[--digitCount];
+        }
+        screen[pos++] = 'C';
+    }
+    write(1, screen, pos);
+}
+
+/* Draws the line being edited after the shell's prompt */
+static void refresh() {
+    draw(state.prompt, state.prompt_length, state.text, state.length, state.cursor);
+}
+
+/* Returns the next byte from the terminal, handling events while waiting
+
+Takes no arguments
+
+Returns:
+    the byte
+    -1 at end of input
+    -2 if the terminal could not be read
+*/
+static int read_byte() {
+    struct pollfd watch[2] = {
+        {state.fd, POLLIN, 0},
+        {state.event_fd, POLLIN, 0},
+    };
+    int readLength;
+
+    while (inputStart == inputEnd) {
+        if (state.event_fd != -1) {
+            if (poll(watch, 2, -1) == -1) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                return -2;
+            }
+            if (watch[1].revents & POLLIN) {
+                // reports go on a clean row, then the line is put back under them
+                write(1, "\r\x1b[0K", 5);
+                state.event_handler();
+                refresh();
+            }
+            if (watch[0].revents == 0) {
+                continue;
+            }
+        }
+        readLength = read(state.fd, input, sizeof(input));
+        if (readLength == -1 && errno == EINTR) {
+            continue;
+        }
+        if (readLength <= 0) {
+            return readLength == 0 ? -1 : -2;
+        }
+        inputStart = 0;
+        inputEnd = readLength;
+    }
+    return (unsigned char)input[inputStart++];
+}
+
+/* Returns the next key, turning the escape sequences of arrows, Home, End
+and Delete into single key codes. An unknown sequence is skipped
+
+Takes no arguments
+
+Returns:
+    the key
+    -1 at end of input
+    -2 if the terminal could not be read
+*/
+static int read_key() {
+    int c = read_byte();
+    int next;
+
+    if (c != KEY_ESCAPE) {
+        return c;
+    }
+    next = read_byte();
+    if (next != '[' && next != 'O') {
+        return next < 0 ? next : 0;
+    }
+    c = read_byte();
+    if (c >= '0' && c <= '9') {
+        // ESC [ n ~
+        next = read_byte();
+        if (next != '~') {
+            return next < 0 ? next : 0;
+        }
+        if (c == '1' || c == '7') {
+            return KEY_HOME;
+        }
+        if (c == '4' || c == '8') {
+            return KEY_END;
+        }
+        return c == '3' ? KEY_DELETE : 0;
+    }
+    switch (c) {
+        case 'A':
+            return KEY_UP;
+        case 'B':
+            return KEY_DOWN;
+        case 'C':
+            return KEY_RIGHT;
+        case 'D':
+            return KEY_LEFT;
+        case 'H':
+            return KEY_HOME;
+        case 'F':
+            return KEY_END;
+    }
+    return c < 0 ? c : 0;
+}
+
+/* Inserts text at the cursor, as much as fits
+
+text - the text to insert
+length - the number of characters in text
+
+No return values
+*/
+static void insert_text(const char *text, unsigned int length) {
+    if (length > EDIT_LINE_MAX - state.length) {
+        length = EDIT_LINE_MAX - state.length;
+    }
+    memmove(state.text + state.cursor + length, state.text + state.cursor, state.length - state.cursor);
+    memcpy(state.text + state.cursor, text, length);
+    state.length += length;
+    state.cursor += length;
+}
+
+/* Removes the characters from one position up to another
+
+from - the first character to remove
+to - one past the last character to remove
+
+No return values
+*/
+static void delete_text(unsigned int from, unsigned int to) {
+    memmove(state.text + from, state.text + to, state.length - to);
+    state.length -= to - from;
+    if (state.cursor >= to) {
+        state.cursor -= to - from;
+    } else if (state.cursor > from) {
+        state.cursor = from;
+    }
+}
+
+/* Returns the position of the character before or after a position, stepping over UTF-8 continuation bytes */
+static unsigned int previous_char(unsigned int pos) {
+    if (pos > 0) {
+        pos -= 1;
+    }
+    while (pos > 0 && ((unsigned char)state.text[pos] & 0xc0) == 0x80) {
+        pos -= 1;
+    }
+    return pos;
+}
+
+static unsigned int next_char(unsigned int pos) {
+    if (pos < state.length) {
+        pos += 1;
+    }
+    while (pos < state.length && ((unsigned char)state.text[pos] & 0xc0) == 0x80) {
+        pos += 1;
+    }
+    return pos;
+}
+
+/* Replaces the line with a history entry, or with the new line being typed
+when number is one past the last entry
+
+number - the entry to show
+
+Returns:
+    0 if the entry was shown
+    -1 if there is no such entry
+*/
+static int show_history(unsigned long number) {
+    const char *text;
+    int length;
+
+    if (number == state.history_last + 1) {
+        memcpy(state.text, state.draft, state.draft_length);
+        state.length = state.draft_length;
+    } else {
+        length = history_get(number, &text);
+        if (length < 0) {
+            return -1;
+        }
+        if (length > EDIT_LINE_MAX) {
+            length = EDIT_LINE_MAX;
+        }
+        // leaving the new line, so keep what was typed
+        if (state.history_index == state.history_last + 1) {
+            memcpy(state.draft, state.text, state.length);
+            state.draft_length = state.length;
+        }
+        memcpy(state.text, text, length);
+        state.length = length;
+    }
+    state.cursor = state.length;
+    state.history_index = number;
+    return 0;
+}
+
+/* Finds the newest history entry at or before a number that contains a query
+
+query - the text to look for
+length - the number of characters in query
+from - the newest entry to look at
+position - set to where the query starts in the entry found
+
+Returns:
+    the number of the entry
+    0 if no entry contains the query
+*/
+static unsigned long search_history(const char *query, unsigned int length, unsigned long from, unsigned int *position) {
+    const char *text;
+    const char *found;
+    int entryLength;
+
+    for (unsigned long number = from; number > 0; number--) {
+        entryLength = history_get(number, &text);
+        if (entryLength >= 0 && (found = memmem(text, entryLength, query, length)) != NULL) {
+            *position = found - text;
+            return number;
+        }
+    }
+    return 0;
+}
+
+/* Runs an incremental reverse search of the history for the text typed
+after Ctrl-R. Another Ctrl-R finds an older match, Ctrl-G gives up and puts
+the line back, and any other key takes the match as the line and is then
+handled as usual
+
+Takes no arguments
+
+Returns:
+    the key that ended the search, 0 if none is left to handle
+    -1 at end of input
+    -2 if the terminal could not be read
+*/
+static int reverse_search() {
+    char query[EDIT_QUERY_MAX];
+    char prompt[sizeof(FAILED_SEARCH_PROMPT) + EDIT_QUERY_MAX + 3];
+    unsigned int queryLength = 0;
+    unsigned long match = 0;
+    unsigned long found;
+    unsigned int position = 0;
+    int failed = 0;
+    int c;
+
+    while (1) {
+        const char *text = "";
+        int length = 0;
+        unsigned int promptLength;
+        const char *lead = failed ? FAILED_SEARCH_PROMPT : SEARCH_PROMPT;
+
+        promptLength = mystrlen(lead);
+        memcpy(prompt, lead, promptLength);
+        memcpy(prompt + promptLength, query, queryLength);
+        memcpy(prompt + promptLength + queryLength, "': ", 3);
+        promptLength += queryLength + 3;
+        if (match > 0) {
+            length = history_get(match, &text);
+        }
+        draw(prompt, promptLength, text, length > 0 ? length : 0, length > 0 ? position : 0);
+
+        c = read_key();
+        if (c == KEY_CTRL('g')) {
+            refresh();
+            return 0;
+        }
+        if (c == KEY_CTRL('r') || c == KEY_BACKSPACE || c == KEY_CTRL('h') || (c >= ' ' && c < 256)) {
+            unsigned long from = match > 0 ? match : state.history_last;
+
+            if (c == KEY_CTRL('r')) {
+                from = match > 1 ? match - 1 : 0;
+            } else if (c == KEY_BACKSPACE || c == KEY_CTRL('h')) {
+                queryLength -= queryLength > 0;
+                from = state.history_last;
+            } else if (queryLength < EDIT_QUERY_MAX) {
+                query[queryLength++] = c;
+            }
+            found = queryLength > 0 ? search_history(query, queryLength, from, &position) : 0;
+            failed = queryLength > 0 && found == 0;
+            if (found > 0 || queryLength == 0) {
+                match = found;
+            }
+            continue;
+        }
+        // anything else takes the match and is handled by the editor
+        if (match > 0 && show_history(match) == 0) {
+            state.cursor = position;
+        }
+        refresh();
+        return c;
+    }
+}
+
+/* Finds the word the cursor is at the end of, if it is in the position of a
+command name: first on the line or after |, & or ;
+
+start - set to where the word starts
+
+Returns:
+    1 if a command name is being typed
+    0 if not
+*/
+static int command_word(unsigned int *start) {
+    unsigned int pos = state.cursor;
+
+    while (pos > 0 && state.text[pos - 1] != ' ' && state.text[pos - 1] != '\t'
+            && state.text[pos - 1] != '|' && state.text[pos - 1] != '&' && state.text[pos - 1] != ';') {
+        pos -= 1;
+    }
+    *start = pos;
+    for (unsigned int i = pos; i < state.cursor; i++) {
+        // a path, quotes or escapes are not completed as command names
+        if (state.text[i] == '/' || state.text[i] == '\'' || state.text[i] == '"' || state.text[i] == '\\') {
+            return 0;
+        }
+    }
+    while (pos > 0 && (state.text[pos - 1] == ' ' || state.text[pos - 1] == '\t')) {
+        pos -= 1;
+    }
+    return pos == 0 || state.text[pos - 1] == '|' || state.text[pos - 1] == '&' || state.text[pos - 1] == ';';
+}
+
+/* Completes the command name at the cursor with what every match shares,
+adding a space when only one name matches. A second tab in a row lists the
+matches instead
+
+again - 1 if the previous key was also a tab
+
+No return values
+*/
+static void complete(int again) {
+    char common[COMPLETE_NAME_MAX];
+    unsigned int start;
+    int count;
+
+    if (!command_word(&start) || (state.cursor < state.length && state.text[state.cursor] != ' ')) {
+        write(1, "\a", 1);
+        return;
+    }
+    count = complete_command(state.text + start, state.cursor - start, common);
+    if (count <= 0) {
+        write(1, "\a", 1);
+        return;
+    }
+    if (common[0] != '\0' || count == 1) {
+        insert_text(common, mystrlen(common));
+        if (count == 1) {
+            insert_text(" ", 1);
+        }
+        refresh();
+        return;
+    }
+    if (!again) {
+        write(1, "\a", 1);
+        return;
+    }
+    write(1, "\n", 1);
+    print_completions(1, state.text + start, state.cursor - start, EDIT_LIST_MAX);
+    refresh();
+}
+
+int edit_line(int fd, const char *prompt, unsigned int promptLength, int eventFd, void (*eventHandler)(), char **line) {
+    struct termios saved;
+    struct termios raw;
+    int previous = 0;
+    int pending = 0;
+    int result = 0;
+    int c;
+
+    if (tcgetattr(fd, &saved) == -1) {
+        return -2;
+    }
+    raw = saved;
+    raw.c_iflag &= ~(BRKINT | ICRNL | INPCK | ISTRIP | IXON);
+    raw.c_cflag |= CS8;
+    raw.c_lflag &= ~(ECHO | ICANON | IEXTEN | ISIG);
+    raw.c_cc[VMIN] = 1;
+    raw.c_cc[VTIME] = 0;
+    tcsetattr(fd, TCSADRAIN, &raw);
+
+    state.fd = fd;
+    state.prompt = prompt;
+    state.prompt_length = promptLength;
+    state.event_fd = eventFd;
+    state.event_handler = eventHandler;
+    state.length = 0;
+    state.cursor = 0;
+    state.draft_length = 0;
+    state.history_last = history_enabled() ? history_count() : 0;
+    state.history_index = state.history_last + 1;
+    refresh();
+
+    while (result == 0) {
+        // a key that ended a search is handled here as if just typed
+        c = pending != 0 ? pending : read_key();
+        pending = 0;
+        switch (c) {
+            case -1:
+            case -2:
+                result = c;
+                break;
+            case '\r':
+            case '\n':
+                state.cursor = state.length;
+                refresh();
+                write(1, "\n", 1);
+                state.text[state.length] = '\n';
+                result = state.length + 1;
+                break;
+            case KEY_CTRL('c'):
+                write(1, "^C\n", 3);
+                state.length = 0;
+                state.cursor = 0;
+                state.history_index = state.history_last + 1;
+                refresh();
+                break;
+            case KEY_CTRL('d'):
+                if (state.length == 0) {
+                    write(1, "\n", 1);
+                    result = -1;
+                    break;
+                }
+                delete_text(state.cursor, next_char(state.cursor));
+                refresh();
+                break;
+            case KEY_DELETE:
+                delete_text(state.cursor, next_char(state.cursor));
+                refresh();
+                break;
+            case KEY_BACKSPACE:
+            case KEY_CTRL('h'):
+                delete_text(previous_char(state.cursor), state.cursor);
+                refresh();
+                break;
+            case KEY_LEFT:
+            case KEY_CTRL('b'):
+                state.cursor = previous_char(state.cursor);
+                refresh();
+                break;
+            case KEY_RIGHT:
+            case KEY_CTRL('f'):
+                state.cursor = next_char(state.cursor);
+                refresh();
+                break;
+            case KEY_HOME:
+            case KEY_CTRL('a'):
+                state.cursor = 0;
+                refresh();
+                break;
+            case KEY_END:
+            case KEY_CTRL('e'):
+                state.cursor = state.length;
+                refresh();
+                break;
+            case KEY_UP:
+            case KEY_CTRL('p'):
+                if (state.history_index > 1 && show_history(state.history_index - 1) == 0) {
+                    refresh();
+                }
+                break;
+            case KEY_DOWN:
+            case KEY_CTRL('n'):
+                if (state.history_index <= state.history_last && show_history(state.history_index + 1) == 0) {
+                    refresh();
+                }
+                break;
+            case KEY_CTRL('w'): {
+                unsigned int start = state.cursor;
+
+                while (start > 0 && state.text[start - 1] == ' ') {
+                    start -= 1;
+                }
+                while (start > 0 && state.text[start - 1] != ' ') {
+                    start -= 1;
+                }
+                delete_text(start, state.cursor);
+                refresh();
+                break;
+            }
+            case KEY_CTRL('u'):
+                delete_text(0, state.cursor);
+                refresh();
+                break;
+            case KEY_CTRL('k'):
+                state.length = state.cursor;
+                refresh();
+                break;
+            case KEY_CTRL('l'):
+                write(1, "\x1b[H\x1b[2J", 7);
+                refresh();
+                break;
+            case KEY_CTRL('r'):
+                pending = reverse_search();
+                break;
+            case '\t':
+                complete(previous == '\t');
+                break;
+            default:
+                // printable characters, including each byte of a UTF-8 character
+                if (c >= ' ' && c < 256) {
+                    char byte = c;
+                    insert_text(&byte, 1);
+                    // a paste is drawn once, after its last character
+                    if (inputStart == inputEnd) {
+                        refresh();
+                    }
+                }
+                break;
+        }
+        previous = c;
+    }
+
+    tcsetattr(fd, TCSADRAIN, &saved);
+    if (result < 0) {
+        return result == -1 ? 0 : -2;
+    }
+    *line = state.text;
+    return result;
+}
@@ -0,0 +1,37 @@
+#ifndef LINE_EDIT_H
+#define LINE_EDIT_H
+
+#define EDIT_LINE_MAX 65536         /* longest line the editor holds, keys typed beyond it are ignored */
+#define EDIT_INPUT_SIZE 4096        /* bytes read from the terminal at once, the rest wait for the next line */
+#define EDIT_QUERY_MAX 256          /* longest reverse search query */
+#define EDIT_LIST_MAX 200           /* most completions listed by a second tab */
+
+/* Reads a line from a terminal in raw mode, redrawing it on one row that
+scrolls sideways when it is wider than the terminal. Keys:
+  left, right, Ctrl-B, Ctrl-F    move by a character
+  Home, End, Ctrl-A, Ctrl-E      move to the start or end
+  up, down, Ctrl-P, Ctrl-N       step through the history
+  Backspace, Delete, Ctrl-D      delete before or under the cursor (Ctrl-D on an empty line is end of input)
+  Ctrl-W, Ctrl-U, Ctrl-K         delete the word before the cursor, everything before it, everything after it
+  Ctrl-R                         search the history backwards for the text typed, again for an older match
+  Tab                            complete a command name, twice to list the choices
+  Ctrl-C                         abandon the line
+  Ctrl-L                         clear the screen
+The terminal is put back in its previous mode before returning. Keys typed
+ahead of the prompt are kept for the next line
+
+fd - the terminal to read from, the line is drawn on fd 1
+prompt - the prompt to draw before the line
+promptLength - the number of characters in the prompt
+eventFd - a file descriptor watched while waiting for keys, -1 for none
+eventHandler - called when eventFd is readable, after which the line is drawn again
+line - set to the line, which stays valid until the next call
+
+Returns:
+    the length of the line including its '\n' if successful
+    0 at end of input
+    -2 if the terminal could not be read
+*/
+int edit_line(int fd, const char *prompt, unsigned int promptLength, int eventFd, void (*eventHandler)(), char **line);
+
+#endif
@@ -0,0 +1,234 @@
+#define _GNU_SOURCE
+#include "linereader.h"
+#include <unistd.h>
+#include <errno.h>
+#include <sys/mman.h>
+#include <poll.h>
+
+
+void reader_init(struct LineReader *reader, int fd) {
+    reader->fd = fd;
+    reader->buffer = NULL;
+    reader->capacity = 0;
+    reader->start = 0;
+    reader->end = 0;
+    reader->eof = 0;
+    reader->event_handler = NULL;
+}
+
+void reader_set_event(struct LineReader *reader, int fd, void (*handler)()) {
+    reader->event_fd = fd;
+    reader->event_handler = handler;
+}
+
+/* Blocks until the reader's fd has input, handling events from the
+watched fd in the meantime
+
+reader - the reader to wait for
+
+No return values
+*/
+static void wait_for_input(struct LineReader *reader) {
+    struct pollfd watch[2] = {
+        {reader->fd, POLLIN, 0},
+        {reader->event_fd, POLLIN, 0},
+    };
+
+    while (1) {
+        if (poll(watch, 2, -1) == -1) {
+            if (errno == EINTR) {
+                continue;
+            }
+            return;
+        }
+        if (watch[1].revents & POLLIN) {
+            reader->event_handler();
+        }
+        // hang ups and errors are left for read() to report
+        if (watch[0].revents != 0) {
+            return;
+        }
+    }
+}
+
+void reader_release(struct LineReader *reader) {
+    if (reader->buffer != NULL) {
+        munmap(reader->buffer, reader->capacity);
+    }
+    reader->buffer = NULL;
+    reader->capacity = 0;
+    reader->start = 0;
+    reader->end = 0;
+}
+
+/* Makes the buffer at least the given size, mapping it if needed
+
+reader - the reader to grow
+size - the smallest acceptable capacity
+
+Returns:
+    0 if successful
+    -1 if no memory was available
+*/
+static int ensure_capacity(struct LineReader *reader, unsigned int size) {
+    unsigned int newCapacity = reader->capacity == 0 ? READER_CAPACITY : reader->capacity;
+    char *newBuffer;
+
+    while (newCapacity < size) {
+        newCapacity *= 2;
+    }
+    if (newCapacity == reader->capacity) {
+        return 0;
+    }
+
+    if (reader->buffer == NULL) {
+        newBuffer = mmap(NULL, newCapacity, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    } else {
+        newBuffer = mremap(reader->buffer, reader->capacity, newCapacity, MREMAP_MAYMOVE);
+    }
+    if (newBuffer == MAP_FAILED) {
+        return -1;
+    }
+    reader->buffer = newBuffer;
+    reader->capacity = newCapacity;
+    return 0;
+}
+
+int reader_init_string(struct LineReader *reader, const char *text) {
+    unsigned int length = 0;
+
+    reader_init(reader, -1);
+    reader->eof = 1;
+    while (text[length] != '\0') {
+        length += 1;
+    }
+    // leave room for a final newline
+    if (length >= READER_MAX_CAPACITY || ensure_capacity(reader, length + 1) != 0) {
+        return -1;
+    }
+    for (unsigned int i = 0; i < length; i++) {
+        reader->buffer[i] = text[i];
+    }
+    reader->end = length;
+    return 0;
+}
+
+/* Finds the first newline in the unconsumed part of the buffer
+
+reader - the reader to search
+from - the offset to start searching at
+
+Returns:
+    the offset of the newline
+    -1 if no newline is buffered
+*/
+static int find_newline(struct LineReader *reader, unsigned int from) {
+    for (unsigned int i = from; i < reader->end; i++) {
+        if (reader->buffer[i] == '\n') {
+            return i;
+        }
+    }
+    return -1;
+}
+
+/* Slides unconsumed bytes to the front of the buffer
+
+reader - the reader to compact
+
+No return values
+*/
+static void compact(struct LineReader *reader) {
+    unsigned int leftover = reader->end - reader->start;
+
+    if (reader->start == 0) {
+        return;
+    }
+    for (unsigned int i = 0; i < leftover; i++) {
+        reader->buffer[i] = reader->buffer[reader->start + i];
+    }
+    reader->start = 0;
+    reader->end = leftover;
+}
+
+/* Compacts the buffer and reads as much as will fit after the leftover bytes
+
+reader - the reader to refill
+
+Returns:
+    the number of bytes read
+    0 at end of input
+    -1 if read() failed
+*/
+static int refill(struct LineReader *reader) {
+    int readLength;
+
+    compact(reader);
+    if (reader->event_handler != NULL) {
+        wait_for_input(reader);
+    }
+    do {
+        readLength = read(reader->fd, reader->buffer + reader->end, reader->capacity - reader->end);
+    } while (readLength == -1 && errno == EINTR);
+
+    if (readLength > 0) {
+        reader->end += readLength;
+    } else if (readLength == 0) {
+        reader->eof = 1;
+    }
+    return readLength;
+}
+
+int read_line(struct LineReader *reader, char **line) {
+    unsigned int searched = reader->start;
+    int newline = find_newline(reader, searched);
+    int discarding = 0;
+    unsigned int lineStart;
+
+    if (reader->buffer == NULL && ensure_capacity(reader, READER_CAPACITY) != 0) {
+        return -2;
+    }
+
+    while (newline == -1) {
+        if (reader->eof) {
+            if (reader->start == reader->end || discarding) {
+                reader->start = reader->end;
+                return discarding ? -1 : 0;
+            }
+            // Last line has no newline, supply one
+            compact(reader);
+            if (reader->end == reader->capacity && ensure_capacity(reader, reader->end + 1) != 0) {
+                return -2;
+            }
+            reader->buffer[reader->end] = '\n';
+            newline = reader->end;
+            reader->end += 1;
+            break;
+        }
+
+        // A full buffer with no newline must grow, or throw the line away at the limit
+        if (reader->start == 0 && reader->end == reader->capacity) {
+            if (reader->capacity >= READER_MAX_CAPACITY) {
+                discarding = 1;
+                reader->end = 0;
+            } else if (ensure_capacity(reader, reader->capacity + 1) != 0) {
+                return -2;
+            }
+        }
+
+        searched = reader->end - reader->start;
+        if (refill(reader) == -1) {
+            return -2;
+        }
+        newline = find_newline(reader, searched);
+
+        if (discarding && newline != -1) {
+            reader->start = newline + 1;
+            return -1;
+        }
+    }
+
+    lineStart = reader->start;
+    reader->start = newline + 1;
+    *line = reader->buffer + lineStart;
+    return reader->start - lineStart;
+}
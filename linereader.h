@@ -0,0 +1,79 @@
+#ifndef LINE_READER_H
+#define LINE_READER_H
+
+#define READER_CAPACITY 65536           /* initial buffer size, and the most requested per read */
+#define READER_MAX_CAPACITY 16777216    /* longest line the buffer will grow to hold */
+
+/* Buffered line reader. Bytes left over after a line stay in the buffer
+for the next call, so several lines from one read() are never lost.
+The buffer is mmap'd on first use and doubles when a line does not fit */
+struct LineReader
+{
+  int fd;                           /* file descriptor lines are read from */
+  char *buffer;                     /* NULL until the first refill */
+  unsigned int capacity;            /* size of buffer */
+  unsigned int start;               /* first unconsumed byte */
+  unsigned int end;                 /* one past the last valid byte */
+  int eof;                          /* 1 once read() has returned 0 */
+  int event_fd;                     /* watched while waiting for input, if event_handler is set */
+  void (*event_handler)();          /* called when event_fd is readable, NULL for none */
+};
+
+/* Prepares a reader to read lines from a file descriptor
+
+reader - the reader to initialize
+fd - the file descriptor to read from
+
+No return values
+*/
+void reader_init(struct LineReader *reader, int fd);
+
+/* Makes the reader watch a second file descriptor while it waits for input.
+Whenever that descriptor becomes readable the handler is called, then the
+wait for input continues, so waiting never needs a timeout
+
+reader - the reader to configure
+fd - the file descriptor to watch
+handler - called when fd is readable, NULL to stop watching
+
+No return values
+*/
+void reader_set_event(struct LineReader *reader, int fd, void (*handler)());
+
+/* Prepares a reader to return the lines of a string. The string is copied,
+so it does not need to outlive the reader
+
+reader - the reader to initialize
+text - the null terminated text to read lines from
+
+Returns:
+    0 if successful
+    -1 if the text does not fit in the buffer
+*/
+int reader_init_string(struct LineReader *reader, const char *text);
+
+/* Unmaps the buffer of a reader. The reader must be initialized again before reuse
+
+reader - the reader to release
+
+No return values
+*/
+void reader_release(struct LineReader *reader);
+
+/* Returns the next line from the reader, refilling with large reads only
+when no complete line is buffered. The line always ends in '\n', one is
+supplied if the input ends without one. The line stays valid until the
+next call on the same reader.
+
+reader - the reader to take the line from
+line - set to the start of the line
+
+Returns:
+    the length of the line including the '\n' if successful
+    0 at end of input
+    -1 if the line is longer than READER_MAX_CAPACITY (the line is discarded)
+    -2 if read() failed or no memory was available
+*/
+int read_line(struct LineReader *reader, char **line);
+
+#endif
@@ -1,24 +1,156 @@
 #include "myheap.h"
+#include <sys/mman.h>
+#include <stddef.h>
 
-#define HEAP_SIZE 4096     /* adjust as necessary */
+/* Header at the start of every mapped chunk */
+struct ArenaChunk
+{
+  struct ArenaChunk *next;
+  unsigned long size;       /* total mapped size, header included */
+};
+
+#define CHUNK_HEADER_SIZE ((sizeof(struct ArenaChunk) + ARENA_ALIGN - 1) & ~(unsigned long)(ARENA_ALIGN - 1))
+#define PAGE_ROUND(n) (((n) + 4095) & ~(unsigned long)4095)
+
+static struct Arena jobHeap;
+static struct Arena *activeHeap = &jobHeap;    /* arena behind alloc and free_all */
+
+
+/* Maps a new chunk able to hold at least the given number of bytes and
+makes it the current chunk of the arena
+
+arena - the arena to grow
+size - the number of bytes the chunk must be able to hold
+
+Returns:
+    0 if successful
+    -1 if the size overflows or mmap failed
+*/
+static int add_chunk(struct Arena *arena, unsigned long size) {
+    unsigned long chunkSize;
+    struct ArenaChunk *chunk;
+
+    if (size > ~0UL - CHUNK_HEADER_SIZE - 4096) {
+        return -1;
+    }
+    chunkSize = PAGE_ROUND(size + CHUNK_HEADER_SIZE);
+    if (chunkSize < ARENA_CHUNK_SIZE) {
+        chunkSize = ARENA_CHUNK_SIZE;
+    }
+
+    chunk = mmap(NULL, chunkSize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+    if (chunk == MAP_FAILED) {
+        return -1;
+    }
+    chunk->next = NULL;
+    chunk->size = chunkSize;
+
+    if (arena->first == NULL) {
+        arena->first = chunk;
+    } else {
+        arena->current->next = chunk;
+    }
+    arena->current = chunk;
+    arena->freep = (char *)chunk + CHUNK_HEADER_SIZE;
+    arena->limit = (char *)chunk + chunkSize;
+
+    arena->chunks += 1;
+    arena->mapped += chunkSize;
+    if (arena->mapped > arena->peak_mapped) {
+        arena->peak_mapped = arena->mapped;
+    }
+    return 0;
+}
+
+char *arena_alloc(struct Arena *arena, unsigned long size) {
+    char *result;
 
-static char heap[HEAP_SIZE];
-static char *freep = heap;
+    // Round up so the next allocation stays aligned, checking for wrap around
+    if (size > ~0UL - ARENA_ALIGN) {
+        return NULL;
+    }
+    size = (size + ARENA_ALIGN - 1) & ~(unsigned long)(ARENA_ALIGN - 1);
 
+    // Compare remaining space rather than pointers so huge sizes can't wrap
+    if (arena->current == NULL || size > (unsigned long)(arena->limit - arena->freep)) {
+        if (add_chunk(arena, size) != 0) {
+            return NULL;
+        }
+    }
 
-char *alloc(unsigned int size)
+    result = arena->freep;
+    arena->freep += size;
+    arena->used += size;
+    if (arena->used > arena->high_water) {
+        arena->high_water = arena->used;
+    }
+    return result;
+}
+
+void arena_reset(struct Arena *arena) {
+    struct ArenaChunk *chunk;
+    struct ArenaChunk *next;
+
+    if (arena->first == NULL) {
+        return;
+    }
+    // Give back every chunk after the first
+    chunk = arena->first->next;
+    while (chunk != NULL) {
+        next = chunk->next;
+        arena->mapped -= chunk->size;
+        arena->chunks -= 1;
+        munmap(chunk, chunk->size);
+        chunk = next;
+    }
+    arena->first->next = NULL;
+    arena->current = arena->first;
+    arena->freep = (char *)arena->first + CHUNK_HEADER_SIZE;
+    arena->limit = (char *)arena->first + arena->first->size;
+    arena->used = 0;
+}
+
+void arena_release(struct Arena *arena) {
+    arena_reset(arena);
+    if (arena->first != NULL) {
+        arena->mapped -= arena->first->size;
+        arena->chunks -= 1;
+        munmap(arena->first, arena->first->size);
+    }
+    arena->first = NULL;
+    arena->current = NULL;
+    arena->freep = NULL;
+    arena->limit = NULL;
+}
+
+void arena_stats(struct Arena *arena, struct HeapStats *stats) {
+    stats->used = arena->used;
+    stats->high_water = arena->high_water;
+    stats->mapped = arena->mapped;
+    stats->peak_mapped = arena->peak_mapped;
+    stats->chunks = arena->chunks;
+}
+
+
+char *alloc(unsigned long size)
 {
-  freep += size;
-  return freep - size;
+  return arena_alloc(activeHeap, size);
 }
 
 
 void free_all()
 {
-  freep = heap;
+  arena_reset(activeHeap);
   return;
 }
 
-char *heap_start() {
-  return heap;
+struct Arena *swap_job_heap(struct Arena *arena) {
+  struct Arena *previous = activeHeap;
+
+  activeHeap = arena != NULL ? arena : &jobHeap;
+  return previous;
+}
+
+void heap_stats(struct HeapStats *stats) {
+  arena_stats(activeHeap, stats);
 }
@@ -1,31 +1,110 @@
 #ifndef MY_HEAP_H
 #define MY_HEAP_H
 
-/* Allocates the given amount of space to the heap
+#define ARENA_CHUNK_SIZE 65536     /* size of each mmap'd chunk, larger requests get their own */
+#define ARENA_ALIGN 8              /* every allocation starts on this boundary */
+
+struct ArenaChunk;
+
+/* A growable bump allocator. Memory comes from a list of mmap'd chunks and
+is only ever given back all at once by arena_reset or arena_release.
+A zero initialized Arena is empty and ready to use */
+struct Arena
+{
+  struct ArenaChunk *first;     /* first chunk, kept mapped across resets */
+  struct ArenaChunk *current;   /* chunk allocations are taken from */
+  char *freep;                  /* next free byte in the current chunk */
+  char *limit;                  /* one past the last byte of the current chunk */
+  unsigned long used;           /* bytes handed out since the last reset */
+  unsigned long high_water;     /* largest value used has reached */
+  unsigned long mapped;         /* bytes currently mapped */
+  unsigned long peak_mapped;    /* largest value mapped has reached */
+  unsigned int chunks;          /* number of chunks currently mapped */
+};
+
+/* Usage figures for an arena */
+struct HeapStats
+{
+  unsigned long used;
+  unsigned long high_water;
+  unsigned long mapped;
+  unsigned long peak_mapped;
+  unsigned int chunks;
+};
+
+/* Allocates space from an arena, mapping a new chunk when the current one
+cannot hold the request
+
+arena - the arena to allocate from
+size - the number of bytes to allocate
+
+Returns:
+    a pointer to the start of the allocated space, aligned to ARENA_ALIGN
+    NULL if no memory could be mapped
+*/
+char *arena_alloc(struct Arena *arena, unsigned long size);
+
+/* Frees everything allocated from an arena. The first chunk stays mapped
+so the next round of allocations does not need a system call, every
+other chunk is unmapped
+
+arena - the arena to reset
+
+No return values
+*/
+void arena_reset(struct Arena *arena);
+
+/* Unmaps every chunk of an arena, leaving it empty but still usable
+
+arena - the arena to release
+
+No return values
+*/
+void arena_release(struct Arena *arena);
+
+/* Reports the usage figures of an arena
+
+arena - the arena to report on
+stats - filled in with the figures
+
+No return values
+*/
+void arena_stats(struct Arena *arena, struct HeapStats *stats);
+
+/* Allocates the given amount of space from the job heap
 and returns the pointer to the beginning of that space.
 
 size - the number of chars (bytes) to allocate
 
 Returns
   The pointer which points to the start of the allocated space
+  NULL if the heap could not grow
 */
-char *alloc(unsigned int size);
+char *alloc(unsigned long size);
 
-/* Allocates the given amount of space to the heap
-and returns the pointer to the beginning of that space.
+/* Frees everything allocated from the job heap.
 
 Takes no arguments
 No return values
 */
 void free_all();
 
-/* Returns a pointer to the first item in the heap
+/* Makes alloc and free_all use another arena, so a job can be parsed without
+disturbing the one currently held in the job heap
 
-Takes no arguments
+arena - the arena to use from now on, NULL for the shell's own job heap
 
 Returns:
-    a pointer to the first item in the heap
+    the arena that was in use, to be handed back later
+*/
+struct Arena *swap_job_heap(struct Arena *arena);
+
+/* Reports the usage figures of the job heap
+
+stats - filled in with the figures
+
+No return values
 */
-char *heap_start();
+void heap_stats(struct HeapStats *stats);
 
 #endif
@@ -1,12 +1,139 @@
 #include "jobs.h"
 #include "getjob.h"
 #include "runjob.h"
+#include "launch.h"
+#include "scan.h"
+#include "jobtable.h"
+#include "pipesize.h"
+#include "trace.h"
+#include "env.h"
+#include "history.h"
+#include "mystring.h"
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <signal.h>
+#include <limits.h>
+
+#define EXIT_SYNTAX_ERROR 2         /* status after a command line could not be parsed */
+#define EXIT_NO_SCRIPT 127          /* status when the script file cannot be opened */
+
+const char *usageError = "usage: mysh [-c command | script]\n";
+const char *scriptOpenError = "Error while opening script\n";
+const char *commandLengthError = "Error: -c command is too long\n";
+const char *envInitError = "Error: out of memory for environment\n";
+
+extern char **environ;
+
+/* Chooses where commands come from based on the arguments. Batch input
+(-c, a script, or a stdin that is not a terminal) never shows the prompt
+
+argc - the number of arguments
+argv - the arguments given to mysh
+
+Returns:
+    0 if the input was set up
+    a nonzero exit status for mysh if it was not
+*/
+static int setup_input(int argc, char const *argv[]) {
+    int fd;
+
+    if (argc == 1) {
+        set_job_input(0, isatty(0));
+        return 0;
+    }
+    if (argc == 3 && argv[1][0] == '-' && argv[1][1] == 'c' && argv[1][2] == '\0') {
+        if (set_job_input_string(argv[2]) != 0) {
+            write(1, commandLengthError, 30);
+            return EXIT_SYNTAX_ERROR;
+        }
+        return 0;
+    }
+    if (argc == 2 && argv[1][0] != '-') {
+        fd = launch_shell_fd(open(argv[1], O_RDONLY | O_CLOEXEC));
+        if (fd == -1) {
+            write(1, scriptOpenError, 27);
+            return EXIT_NO_SCRIPT;
+        }
+        set_job_input(fd, 0);
+        return 0;
+    }
+    write(1, usageError, 34);
+    return EXIT_SYNTAX_ERROR;
+}
+
+/* Turns on command history, kept in the file named by MYSH_HISTFILE or
+else in HISTORY_FILE_NAME in the home directory. Without either the
+history only lasts for the session
+
+Takes no arguments
+No return values
+*/
+static void open_history() {
+    char path[PATH_MAX];
+    const char *home = env_get("HOME");
+    int homeLength;
+
+    if (env_get("MYSH_HISTFILE") != NULL) {
+        history_open(env_get("MYSH_HISTFILE"));
+        return;
+    }
+    if (home == NULL || (homeLength = mystrlen(home)) + sizeof(HISTORY_FILE_NAME) + 1 > sizeof(path)) {
+        history_open("");
+        return;
+    }
+    memcpy(path, home, homeLength);
+    path[homeLength] = '/';
+    memcpy(path + homeLength + 1, HISTORY_FILE_NAME, sizeof(HISTORY_FILE_NAME));
+    history_open(path);
+}
 
 int main(int argc, char const *argv[]) {
     int exitRequested = 0;
     int status = 0;
+    int exitStatus = 0;
     struct Job currentJob;
+    long pipeSize;
+
+    // children get the shell's variables, starting with everything it was given
+    if (env_init(environ) != 0) {
+        write(1, envInitError, 37);
+        return 1;
+    }
+
+    // pick the widest delimiter scanner this cpu supports
+    scan_init();
+
+    // MYSH_PIPESIZE=auto or a byte count sets the capacity of pipeline pipes
+    if (getenv("MYSH_PIPESIZE") != NULL && parse_pipe_size(getenv("MYSH_PIPESIZE"), &pipeSize) == 0) {
+        set_pipe_size(pipeSize);
+    }
 
+    // MYSH_TRACE=file records timed events for each phase, MYSH_TRACE_FORMAT=chrome for the trace viewer
+    if (getenv("MYSH_TRACE") != NULL) {
+        trace_init(getenv("MYSH_TRACE"), trace_format_from_name(getenv("MYSH_TRACE_FORMAT")));
+    }
+
+    // a reader going away is reported to builtins as EPIPE instead of killing the shell
+    signal(SIGPIPE, SIG_IGN);
+
+    // only an interactive shell reports background jobs and uses job control
+    jobs_init(argc == 1 && isatty(0));
+
+    // MYSH_LAUNCH=spawn selects posix_spawn instead of fork for new processes, and
+    // MYSH_LAUNCH=zygote forks the launching helper now, after the signals and terminal are set up
+    set_launch_mode(launch_mode_from_name(getenv("MYSH_LAUNCH")));
+
+    exitStatus = setup_input(argc, argv);
+    if (exitStatus != 0) {
+        return exitStatus;
+    }
+
+    // only a shell typed at keeps history, in MYSH_HISTFILE or ~/.mysh_history
+    if (argc == 1 && isatty(0)) {
+        open_history();
+    }
 
     status = get_job(&currentJob);
     if (status == 1) {
@@ -16,9 +143,10 @@ int main(int argc, char const *argv[]) {
     while (!exitRequested) {
         if (status == 0) {
             run_job(&currentJob);
+            exitStatus = last_exit_status();
+        } else {
+            exitStatus = EXIT_SYNTAX_ERROR;
         }
-        
-        check_for_zombies();
 
         status = get_job(&currentJob);
         if (status == 1) {
@@ -26,5 +154,5 @@ int main(int argc, char const *argv[]) {
         }
     }
 
-    return 0;
+    return exitStatus;
 }
@@ -22,3 +22,66 @@ void *mystrcpy(char *dest, const char *src)
         i += 1;
     }
 }
+
+
+int mystrlen(const char *s)
+{
+  int length = 0;
+  while (s[length] != '\0') {
+    length += 1;
+  }
+  return length;
+}
+
+
+int myitoa(long value, char *dest)
+{
+  char digits[20];
+  int count = 0;
+  int length = 0;
+  unsigned long magnitude = value < 0 ? -(unsigned long)value : (unsigned long)value;
+
+  do {
+    digits[count] = '0' + magnitude % 10;
+    magnitude /= 10;
+    count += 1;
+  } while (magnitude > 0);
+
+  if (value < 0) {
+    dest[length] = '-';
+    length += 1;
+  }
+  while (count > 0) {
+    count -= 1;
+    dest[length] = digits[count];
+    length += 1;
+  }
+  return length;
+}
+
+
+int myatoi(const char *src, long *value)
+{
+  unsigned long magnitude = 0;
+  int negative = 0;
+
+  if (*src == '-') {
+    negative = 1;
+    src += 1;
+  }
+  if (*src == '\0') {
+    return -1;
+  }
+  while (*src != '\0') {
+    if (*src < '0' || *src > '9' || magnitude > 922337203685477580UL) {
+      return -1;
+    }
+    magnitude = magnitude * 10 + (*src - '0');
+    src += 1;
+  }
+  if (magnitude > 9223372036854775807UL) {
+    return -1;
+  }
+  *value = negative ? -(long)magnitude : (long)magnitude;
+  return 0;
+}
@@ -21,4 +21,34 @@ No return values
 */
 void *mystrcpy(char *dest, const char *src);
 
+/* Counts the characters in a null-terminated string
+
+s - the string to measure
+
+Returns
+  the number of characters before the null
+*/
+int mystrlen(const char *s);
+
+/* Writes the decimal form of a number, without a null terminator
+
+value - the number to convert
+dest - where to write the digits, needs room for 20 characters
+
+Returns
+  the number of characters written
+*/
+int myitoa(long value, char *dest);
+
+/* Reads a decimal number, with an optional leading '-'
+
+src - the null-terminated digits
+value - set to the number if successful
+
+Returns
+  0 if successful
+  -1 if src is empty, holds anything but digits, or overflows a long
+*/
+int myatoi(const char *src, long *value);
+
 #endif
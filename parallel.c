@@ -0,0 +1,244 @@
+#include "parallel.h"
+#include "parsejob.h"
+#include "expand.h"
+#include "runjob.h"
+#include "jobtable.h"
+#include "myheap.h"
+#include "mystring.h"
+#include <unistd.h>
+#include <signal.h>
+
+#define PARALLEL_PARSE_ERROR 2      /* status reported for a line that could not be parsed */
+#define PARALLEL_START_ERROR 126    /* status reported for a job that could not be started */
+
+const char *nullDevice = "/dev/null";
+const char *listError = "Error: parallel jobs can't be lists or read here-documents\n";
+
+/* A job started by the runner, and the line it came from */
+struct ParallelSlot
+{
+  struct JobEntry *entry;
+  unsigned long number;         /* line number of the job, from 1 */
+};
+
+static volatile sig_atomic_t interrupted = 0;
+
+
+/* Notes that Ctrl-C was pressed, so the runner stops and interrupts its jobs
+
+sig - the signal number (SIGINT)
+
+No return values
+*/
+static void on_interrupt(int sig) {
+    interrupted = 1;
+}
+
+/* Writes one report line, e.g. "12\t0\t1.204\tsleep 1"
+
+out - file descriptor to write to
+number - line number of the job
+status - exit status of the job
+nanoseconds - wall time from start to the last stage being reaped
+command - the command text
+length - the number of characters of command to write
+
+No return values
+*/
+static void report_result(int out, unsigned long number, int status, long nanoseconds,
+                          const char *command, int length) {
+    char text[64];
+    int pos = 0;
+    long millis = nanoseconds / 1000000;
+
+    pos += myitoa(number, text + pos);
+    text[pos++] = '\t';
+    pos += myitoa(status, text + pos);
+    text[pos++] = '\t';
+    pos += myitoa(millis / 1000, text + pos);
+    text[pos++] = '.';
+    text[pos++] = '0' + millis / 100 % 10;
+    text[pos++] = '0' + millis / 10 % 10;
+    text[pos++] = '0' + millis % 10;
+    text[pos++] = '\t';
+    write(out, text, pos);
+    write(out, command, length);
+    write(out, "\n", 1);
+}
+
+/* Gives the first stage of a job /dev/null as its input. The redirection goes
+ahead of the stage's own, so a < of its own still wins
+
+command - the first stage of the job
+
+Returns:
+    0 if successful
+    -1 if the job heap could not hold the redirections
+*/
+static int quiet_input(struct Command *command) {
+    struct Redirection *redirections = (struct Redirection *)alloc(sizeof(struct Redirection) * (command->num_redirections + 1));
+
+    if (redirections == NULL) {
+        return -1;
+    }
+    redirections[0] = (struct Redirection){REDIRECT_INPUT, 0, (char *)nullDevice, -1};
+    for (unsigned int i = 0; i < command->num_redirections; i++) {
+        redirections[i + 1] = command->redirections[i];
+    }
+    command->redirections = redirections;
+    command->num_redirections += 1;
+    return 0;
+}
+
+/* Parses a line into the scratch arena and starts it as a job
+
+line - the job line, ending in '\n'
+length - the number of characters in the line including the '\n'
+scratch - arena the parsed job is held in until it has started
+quietInput - 1 to give the job /dev/null as input if it has no < redirection
+started - set to the entry of the job if one was started
+
+Returns:
+    0 if the job was started
+    1 if the line was blank
+    a nonzero exit status to report if the line could not be run
+*/
+static int start_line(char *line, int length, struct Arena *scratch, int quietInput, struct JobEntry **started) {
+    struct Arena *previous = swap_job_heap(scratch);
+    struct Job job;
+    int result;
+
+    free_all();
+    result = parse_job(line, length, &job);
+    // each line is one job started without waiting, with no lines after it to read a body from
+    if (result == 0 && (job.here_documents > 0 || job.next != NULL)) {
+        write(1, listError, 59);
+        result = -4;
+    }
+    if (result == 0) {
+        result = expand_job(&job);
+    }
+    // a line of assignments would only set variables in the shell, so it is skipped like a blank one
+    if (result == 0 && (job.num_stages == 0 || job.pipeline[0].argc == 0)) {
+        result = 1;
+    } else if (result == 0) {
+        // every job already runs without the shell waiting, & adds nothing
+        job.background = 0;
+        if (quietInput && quiet_input(&job.pipeline[0]) != 0) {
+            result = PARALLEL_START_ERROR;
+        } else {
+            result = start_job(&job, 0, started) == 0 ? 0 : PARALLEL_START_ERROR;
+        }
+    } else {
+        // a malformed line has already been reported
+        result = PARALLEL_PARSE_ERROR;
+    }
+    swap_job_heap(previous);
+    return result;
+}
+
+/* Reports and frees every job in the slots whose stages have all been reaped
+
+slots - the running jobs, finished ones are removed
+running - the number of slots in use, updated
+out - file descriptor to write reports to
+failed - set to 1 if a finished job did not exit with status 0
+
+Returns:
+    the number of jobs collected
+*/
+static unsigned int collect_finished(struct ParallelSlot *slots, unsigned int *running, int out, int *failed) {
+    unsigned int collected = 0;
+    unsigned int i = 0;
+
+    while (i < *running) {
+        struct JobEntry *entry = slots[i].entry;
+        if (entry->remaining != 0) {
+            i += 1;
+            continue;
+        }
+        // returns at once, and marks jobs that never started a process done
+        int status = wait_for_job(entry);
+        long nanoseconds = (entry->finished.tv_sec - entry->started.tv_sec) * 1000000000L
+                           + (entry->finished.tv_nsec - entry->started.tv_nsec);
+        report_result(out, slots[i].number, status, nanoseconds, entry->command, mystrlen(entry->command));
+        if (status != 0) {
+            *failed = 1;
+        }
+        *running -= 1;
+        slots[i] = slots[*running];
+        collected += 1;
+    }
+    return collected;
+}
+
+int run_parallel(struct LineReader *reader, unsigned int limit, int out, int quietInput) {
+    struct ParallelSlot slots[JOB_TABLE_SIZE];
+    struct Arena scratch = {0};
+    struct sigaction action;
+    struct sigaction previousAction;
+    struct JobEntry *entry;
+    unsigned int running = 0;
+    unsigned long number = 0;
+    int failed = 0;
+    int more = 1;
+    int signalled = 0;
+    char *line;
+    int length;
+    int result;
+
+    // no SA_RESTART, so Ctrl-C also ends the wait for a job event
+    interrupted = 0;
+    action.sa_handler = on_interrupt;
+    sigemptyset(&action.sa_mask);
+    action.sa_flags = 0;
+    sigaction(SIGINT, &action, &previousAction);
+
+    while (more || running > 0) {
+        // start jobs until every slot is busy
+        while (more && running < limit && !interrupted) {
+            length = read_line(reader, &line);
+            if (length == 0 || length == -2) {
+                more = 0;
+                break;
+            }
+            number += 1;
+            if (length == -1) {
+                report_result(out, number, PARALLEL_PARSE_ERROR, 0, "", 0);
+                failed = 1;
+                continue;
+            }
+            result = start_line(line, length, &scratch, quietInput, &entry);
+            if (result == 0) {
+                slots[running].entry = entry;
+                slots[running].number = number;
+                running += 1;
+            } else if (result != 1) {
+                report_result(out, number, result, 0, line, length - 1);
+                failed = 1;
+            }
+        }
+
+        if (interrupted && !signalled) {
+            more = 0;
+            signalled = 1;
+            failed = 1;
+            // without job control the jobs share the shell's group and already got it
+            for (unsigned int i = 0; i < running; i++) {
+                if (slots[i].entry->pgid != 0) {
+                    kill(-slots[i].entry->pgid, SIGINT);
+                }
+            }
+        }
+
+        if (collect_finished(slots, &running, out, &failed) == 0 && running > 0) {
+            if (wait_for_job_event() == -1 && !interrupted) {
+                break;
+            }
+        }
+    }
+
+    sigaction(SIGINT, &previousAction, NULL);
+    arena_release(&scratch);
+    return failed;
+}
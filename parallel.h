@@ -0,0 +1,24 @@
+#ifndef PARALLEL_H
+#define PARALLEL_H
+
+#include "linereader.h"
+
+/* Runs each line of the reader as an independent job, keeping at most limit
+jobs running at once. The next line is started as soon as a running job has
+been reaped, and a line "number<TAB>status<TAB>seconds<TAB>command" is
+written for every job as it finishes. Ctrl-C stops new jobs from starting and
+interrupts the running ones
+
+reader - where the job lines come from, read until end of input
+limit - the most jobs to run at once, 1 to JOB_TABLE_SIZE
+out - file descriptor the reports are written to
+quietInput - 1 to give jobs without a < redirection /dev/null as input, so
+             they can't consume lines meant for the runner
+
+Returns:
+    0 if every job exited with status 0
+    1 if any job failed, could not be parsed or could not be started
+*/
+int run_parallel(struct LineReader *reader, unsigned int limit, int out, int quietInput);
+
+#endif
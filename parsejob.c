@@ -0,0 +1,458 @@
+#include "parsejob.h"
+#include "myheap.h"
+#include "scan.h"
+#include <unistd.h>
+#include <string.h>
+
+/* Character classes, every byte of a line maps to exactly one.
+The scanners in scan.c must treat every class but CC_WORD as special */
+#define CC_WORD    0     /* copied into the current word */
+#define CC_SPACE   1     /* ends a word: space, tab, null */
+#define CC_END     2     /* end of the line: \n */
+#define CC_PIPE    3     /* | */
+#define CC_LESS    4     /* < */
+#define CC_GREATER 5     /* > */
+#define CC_AMP     6     /* & */
+#define CC_SQUOTE  7     /* ' starts a literal section */
+#define CC_DQUOTE  8     /* " starts a section where only \" and \\ are escapes */
+#define CC_ESCAPE  9     /* \ makes the next character literal */
+#define CC_SEMI    10    /* ; ends a job, as does & and the && and || found through CC_AMP and CC_PIPE */
+
+/* Bytes that may appear in a variable name, digits only after the first */
+#define NAME_CHAR(c) ((c) == '_' || ((c) >= 'a' && (c) <= 'z') || ((c) >= 'A' && (c) <= 'Z') || ((c) >= '0' && (c) <= '9'))
+
+const char *malCommandError = "Error while processing command: malformed input\n";
+const char *heapError = "Error while processing command: out of memory for command\n";
+const char *keywordTime = "time";
+
+static const unsigned char charClass[256] = {
+    ['\0'] = CC_SPACE, ['\t'] = CC_SPACE, [' '] = CC_SPACE,
+    ['\n'] = CC_END,
+    ['|'] = CC_PIPE, ['<'] = CC_LESS, ['>'] = CC_GREATER, ['&'] = CC_AMP, [';'] = CC_SEMI,
+    ['\''] = CC_SQUOTE, ['"'] = CC_DQUOTE, ['\\'] = CC_ESCAPE,
+};
+
+/* Position of the lexer within the line and within its output */
+struct Lexer
+{
+  char *line;           /* the line being parsed */
+  char *end;            /* one past the last character of the line */
+  unsigned int pos;     /* index of the next character to classify */
+  char *out;            /* where the next word character is written */
+};
+
+
+/* Copies one word starting at the lexer's position to its output,
+removing quotes and escapes, and null terminates it. Quoted characters that
+expansion would treat specially are preceded by QUOTED_CHAR, and each quoted
+section leaves a QUOTED_SECTION, so expand_job knows what was quoted
+
+lexer - the lexer, left on the first character after the word
+
+Returns:
+    a pointer to the start of the word
+    NULL if a quote is not closed or the line ends in a \
+*/
+static char *lex_word(struct Lexer *lexer) {
+    char *line = lexer->line;
+    unsigned int i = lexer->pos;
+    char *out = lexer->out;
+    char *word = out;
+
+    while (1) {
+        switch (charClass[(unsigned char)line[i]]) {
+            case CC_WORD: {
+                // copy the whole run of plain characters found by the vector scanner
+                unsigned int run = scan_word_end(line + i, lexer->end) - (line + i);
+                memcpy(out, line + i, run);
+                out += run;
+                i += run;
+                break;
+            }
+            case CC_SQUOTE:
+                i += 1;
+                *out++ = QUOTED_SECTION;
+                while (line[i] != '\'') {
+                    if (line[i] == '\n') {
+                        return NULL;
+                    }
+                    if (EXPANSION_CHAR(line[i])) {
+                        *out++ = QUOTED_CHAR;
+                    }
+                    *out++ = line[i++];
+                }
+                i += 1;
+                break;
+            case CC_DQUOTE:
+                // $ still expands between double quotes, \$ does not
+                i += 1;
+                *out++ = QUOTED_SECTION;
+                while (line[i] != '"') {
+                    if (line[i] == '\n') {
+                        return NULL;
+                    }
+                    if (line[i] == '\\' && (line[i + 1] == '"' || line[i + 1] == '\\' || line[i + 1] == '$')) {
+                        i += 1;
+                        if (line[i] == '$') {
+                            *out++ = QUOTED_CHAR;
+                        }
+                    } else if (line[i] != '$' && EXPANSION_CHAR(line[i])) {
+                        *out++ = QUOTED_CHAR;
+                    }
+                    *out++ = line[i++];
+                }
+                i += 1;
+                break;
+            case CC_ESCAPE:
+                if (line[i + 1] == '\n') {
+                    return NULL;
+                }
+                if (EXPANSION_CHAR(line[i + 1])) {
+                    *out++ = QUOTED_CHAR;
+                }
+                *out++ = line[i + 1];
+                i += 2;
+                break;
+            default:
+                // whitespace, end of line or a metacharacter ends the word
+                *out++ = '\0';
+                lexer->pos = i;
+                lexer->out = out;
+                return word;
+        }
+    }
+}
+
+/* Checks whether the word at a position is an assignment: an unquoted
+variable name followed by =
+
+line - the line being parsed
+pos - the first character of the word
+
+Returns:
+    1 if the word is an assignment
+    0 if not
+*/
+static int is_assignment(const char *line, unsigned int pos) {
+    unsigned int i = pos;
+
+    if (line[i] >= '0' && line[i] <= '9') {
+        return 0;
+    }
+    while (NAME_CHAR(line[i])) {
+        i += 1;
+    }
+    return i > pos && line[i] == '=';
+}
+
+/* Reads the digits of an fd number
+
+line - the line being parsed
+pos - the first character to look at, left after the digits
+
+Returns:
+    the number, which may be above REDIRECT_MOST_FD
+    -1 if there are no digits
+*/
+static int lex_fd(const char *line, unsigned int *pos) {
+    int fd = 0;
+    unsigned int i = *pos;
+
+    // past REDIRECT_MOST_FD the value no longer matters, only that it is too big
+    while (line[i] >= '0' && line[i] <= '9') {
+        if (fd <= REDIRECT_MOST_FD) {
+            fd = fd * 10 + (line[i] - '0');
+        }
+        i += 1;
+    }
+    if (i == *pos) {
+        return -1;
+    }
+    *pos = i;
+    return fd;
+}
+
+/* Reads a redirection operator: <, >, >>, <<, <<<, <&m or >&m
+
+lexer - the lexer, on the < or >, left after the operator
+fd - the fd written before the operator, -1 if none
+redirection - filled in with the operator, its word is set to NULL
+target - set to the redirection's word if a word must follow the operator
+
+Returns:
+    0 if successful
+    -1 if the operator is malformed
+*/
+static int lex_redirection(struct Lexer *lexer, int fd, struct Redirection *redirection, char ***target) {
+    const char *line = lexer->line;
+    int output = line[lexer->pos] == '>';
+
+    redirection->type = output ? REDIRECT_OUTPUT : REDIRECT_INPUT;
+    redirection->fd = fd != -1 ? fd : output;
+    redirection->word = NULL;
+    redirection->source = -1;
+    lexer->pos += 1;
+
+    if (line[lexer->pos] == '&') {
+        lexer->pos += 1;
+        redirection->type = REDIRECT_DUP;
+        redirection->source = lex_fd(line, &lexer->pos);
+        return redirection->source < 0 || redirection->source > REDIRECT_MOST_FD ? -1 : 0;
+    }
+    if (output && line[lexer->pos] == '>') {
+        redirection->type = REDIRECT_APPEND;
+        lexer->pos += 1;
+    } else if (!output && line[lexer->pos] == '<') {
+        redirection->type = REDIRECT_HEREDOC;
+        lexer->pos += 1;
+        if (line[lexer->pos] == '<') {
+            redirection->type = REDIRECT_STRING;
+            lexer->pos += 1;
+        }
+    }
+    *target = &redirection->word;
+    return 0;
+}
+
+/* Reports a malformed command line
+
+Takes no arguments
+
+Returns:
+    -4, the value parse_job returns for malformed input
+*/
+static int malformed() {
+    write(1, malCommandError, 48);
+    return -4;
+}
+
+/* Starts a command whose words and redirections go at the given places
+
+command - the command
+slots - where its assignments and arguments go
+redirections - where its redirections go
+
+No return values
+*/
+static void begin_command(struct Command *command, char **slots, struct Redirection *redirections) {
+    command->argv = slots;
+    command->assignments = slots;
+    command->num_assignments = 0;
+    command->redirections = redirections;
+    command->num_redirections = 0;
+}
+
+/* Starts a job at the lexer's position. An unquoted leading time is a
+keyword, so it is skipped before any words are lexed
+
+lexer - the lexer, left after the time keyword if there is one
+job - the job, its first command is the one in pipeline[0]
+pipeline - the job's commands
+
+No return values
+*/
+static void begin_job(struct Lexer *lexer, struct Job *job, struct Command *pipeline) {
+    const char *line = lexer->line;
+    unsigned int length = lexer->end - lexer->line;
+
+    job->pipeline = pipeline;
+    job->num_stages = 0;
+    job->background = 0;
+    job->timed = 0;
+    job->here_documents = 0;
+    job->next = NULL;
+    job->next_if = JOB_THEN;
+
+    while (charClass[(unsigned char)line[lexer->pos]] == CC_SPACE && lexer->pos < length) {
+        lexer->pos += 1;
+    }
+    if (length - lexer->pos > 4 && memcmp(line + lexer->pos, keywordTime, 4) == 0
+            && (charClass[(unsigned char)line[lexer->pos + 4]] == CC_SPACE
+                || charClass[(unsigned char)line[lexer->pos + 4]] == CC_END)) {
+        job->timed = 1;
+        lexer->pos += 4;
+    }
+}
+
+int parse_job(char *line, unsigned int length, struct Job *job) {
+    struct Lexer lexer = {line, line + length, 0, NULL};
+    struct Command *commands;   /* the commands of the current job */
+    struct Redirection *redirections;
+    struct Job *previous = NULL;
+    struct Job *list = job;     /* first job of the current and-or list */
+    char **slots;
+    char **target = NULL;       /* redirection waiting for its word, NULL when words are arguments */
+    char *word;
+    unsigned int numSlots = 0;
+    unsigned int numCommands = 0;
+    unsigned int numRedirections = 0;
+    unsigned int jobRedirections = 0;   /* redirections before the current job's first */
+    unsigned int argc = 0;
+    unsigned int digits;
+    int ending;                 /* JOB_ value of the separator that ended the job, -1 while it goes on */
+    int done = 0;
+    int assignment;
+    int fd;
+
+    // Words are never longer than twice the line (every character quoted and
+    // marked), and every word but the last is followed by at least one
+    // separator, which bounds the slots and commands. Every redirection takes
+    // at least two characters too, so the redirections share the commands' block
+    lexer.out = alloc(2 * length + 1);
+    slots = (char **)alloc(sizeof(char *) * (length + 2));
+    commands = (struct Command *)alloc((sizeof(struct Command) + sizeof(struct Redirection)) * (length / 2 + 1));
+    if (lexer.out == NULL || slots == NULL || commands == NULL) {
+        write(1, heapError, 58);
+        return -5;
+    }
+    redirections = (struct Redirection *)(commands + length / 2 + 1);
+    begin_job(&lexer, job, commands);
+    begin_command(&commands[0], slots, redirections);
+
+    while (!done) {
+        ending = -1;
+        switch (charClass[(unsigned char)line[lexer.pos]]) {
+            case CC_SPACE:
+                lexer.pos += 1;
+                break;
+            case CC_END:
+                ending = JOB_THEN;
+                done = 1;
+                break;
+            case CC_SEMI:
+                ending = JOB_THEN;
+                lexer.pos += 1;
+                break;
+            case CC_PIPE:
+                if (line[lexer.pos + 1] == '|') {
+                    ending = JOB_OR;
+                    lexer.pos += 2;
+                    break;
+                }
+                // | needs a command before it and can't follow a redirection operator
+                if (target != NULL || argc == 0) {
+                    return malformed();
+                }
+                commands[numCommands].argc = argc;
+                slots[numSlots++] = NULL;
+                numCommands += 1;
+                begin_command(&commands[numCommands], &slots[numSlots], &redirections[numRedirections]);
+                argc = 0;
+                lexer.pos += 1;
+                break;
+            case CC_LESS:
+            case CC_GREATER:
+                // any stage may redirect any fd, as often as it likes
+                if (target != NULL || lex_redirection(&lexer, -1, &redirections[numRedirections], &target) != 0) {
+                    return malformed();
+                }
+                job->here_documents += redirections[numRedirections].type == REDIRECT_HEREDOC;
+                numRedirections += 1;
+                commands[numCommands].num_redirections += 1;
+                break;
+            case CC_AMP:
+                if (line[lexer.pos + 1] == '&') {
+                    ending = JOB_AND;
+                    lexer.pos += 2;
+                    break;
+                }
+                // & ends the job like ;, but the shell does not wait for it
+                job->background = 1;
+                ending = JOB_THEN;
+                lexer.pos += 1;
+                break;
+            default:
+                // digits straight before < or > name the fd being redirected, not a word
+                if (target == NULL && line[lexer.pos] >= '0' && line[lexer.pos] <= '9') {
+                    digits = lexer.pos;
+                    fd = lex_fd(line, &digits);
+                    if (charClass[(unsigned char)line[digits]] == CC_LESS || charClass[(unsigned char)line[digits]] == CC_GREATER) {
+                        lexer.pos = digits;
+                        if (fd > REDIRECT_MOST_FD
+                                || lex_redirection(&lexer, fd, &redirections[numRedirections], &target) != 0) {
+                            return malformed();
+                        }
+                        job->here_documents += redirections[numRedirections].type == REDIRECT_HEREDOC;
+                        numRedirections += 1;
+                        commands[numCommands].num_redirections += 1;
+                        break;
+                    }
+                }
+                assignment = target == NULL && argc == 0 && is_assignment(line, lexer.pos);
+                word = lex_word(&lexer);
+                if (word == NULL) {
+                    return malformed();
+                }
+                if (target != NULL) {
+                    *target = word;
+                    target = NULL;
+                } else if (assignment) {
+                    // assignments come before the arguments, which start after them
+                    slots[numSlots++] = word;
+                    commands[numCommands].num_assignments += 1;
+                    commands[numCommands].argv = &slots[numSlots];
+                } else {
+                    slots[numSlots++] = word;
+                    argc += 1;
+                }
+                break;
+        }
+        if (ending == -1) {
+            continue;
+        }
+
+        // a separator or the end of the line finishes the job
+        if (target != NULL) {
+            return malformed();
+        }
+        if (argc == 0 && commands[numCommands].num_assignments == 0) {
+            // a job ending in | or holding only redirections is malformed, an empty
+            // one is only allowed as a blank line or after a final ; or &
+            if (numCommands > 0 || numRedirections > jobRedirections || job->background || !done) {
+                return malformed();
+            }
+            if (previous != NULL && previous->next_if != JOB_THEN) {
+                return malformed();
+            }
+            if (previous != NULL) {
+                previous->next = NULL;
+            }
+            return 0;
+        }
+        // a line of assignments is fine, but not with | or redirections, or run with &
+        if (argc == 0 && (numCommands > 0 || numRedirections > jobRedirections || job->background)) {
+            return malformed();
+        }
+        // & puts the whole and-or list in the background, as one job
+        if (job->background) {
+            for (struct Job *part = list; part != job; part = part->next) {
+                part->background = 1;
+            }
+        }
+        commands[numCommands].argc = argc;
+        slots[numSlots++] = NULL;
+        job->num_stages = numCommands + 1;
+        if (done) {
+            return 0;
+        }
+
+        job->next_if = ending;
+        job->next = (struct Job *)alloc(sizeof(struct Job));
+        if (job->next == NULL) {
+            write(1, heapError, 58);
+            return -5;
+        }
+        previous = job;
+        job = job->next;
+        if (ending == JOB_THEN) {
+            list = job;
+        }
+        commands += numCommands + 1;
+        begin_job(&lexer, job, commands);
+        begin_command(&commands[0], &slots[numSlots], &redirections[numRedirections]);
+        jobRedirections = numRedirections;
+        numCommands = 0;
+        argc = 0;
+    }
+    return 0;
+}
@@ -0,0 +1,37 @@
+#ifndef PARSEJOB_H
+#define PARSEJOB_H
+
+#include "jobs.h"
+
+#define QUOTED_CHAR    '\x01'   /* the next character was quoted, so expansion leaves it alone */
+#define QUOTED_SECTION '\x02'   /* a quoted section started here, the word is kept even if it expands to nothing */
+
+/* Characters expand_job looks at, which the lexer marks when they are quoted */
+#define EXPANSION_CHAR(c) ((c) == '$' || (c) == '*' || (c) == '?' || (c) == '[' || (c) == '~' \
+                           || (c) == QUOTED_CHAR || (c) == QUOTED_SECTION)
+
+/* Parses a command line into the supplied job structure in a single pass.
+Each character is classified through a 256 entry table and words are
+copied, with quotes and escapes removed, straight into argv arrays and
+the redirections of their command on the job heap. The job heap must have
+been cleared by the caller. A line of several jobs separated by ;, &, &&
+or || becomes a list: the first job is the supplied one and the rest hang
+off its next field, allocated on the job heap. A leading unquoted time sets
+a job's timed flag and is not part of its first command. Leading NAME=value
+words of each command, with the name and = unquoted, go to its assignments
+instead of argv. Words keep quoting marks until expand_job has been run on
+the job. A here-document is left holding its delimiter and counted in
+here_documents, for the caller to replace with the lines that follow.
+
+line - the command line, ending in '\n'
+length - the number of characters in the line including the '\n'
+job - the job structure to be populated
+
+Returns:
+    0 if run successful (num_stages is 0 for a blank line)
+    -4 if a malformed command is detected
+    -5 if the heap could not hold the job
+*/
+int parse_job(char *line, unsigned int length, struct Job *job);
+
+#endif
@@ -0,0 +1,215 @@
+#include "pathcache.h"
+#include "myheap.h"
+#include "mystring.h"
+#include "env.h"
+#include <unistd.h>
+#include <sys/stat.h>
+
+#define PATH_BUFFER_SIZE 4096     /* longest directory/name candidate tried */
+
+const char *defaultPath = "/usr/local/bin:/usr/bin:/bin";
+
+/* A remembered command location, chained within its bucket */
+struct CacheEntry
+{
+  struct CacheEntry *next;
+  char *name;
+  char *path;
+  unsigned long hits;
+};
+
+static struct CacheEntry *buckets[CACHE_BUCKETS];
+static struct Arena cacheArena;     /* entries and strings, released together */
+static char *cachedPath = NULL;     /* the $PATH the entries were found with */
+static char uncachedPath[PATH_BUFFER_SIZE];   /* the last hit in a relative directory, which is never cached */
+
+
+/* Hashes a command name with FNV-1a
+
+name - the null terminated name to hash
+
+Returns:
+    the bucket index for the name
+*/
+static unsigned int hash_name(const char *name) {
+    unsigned int hash = 2166136261u;
+
+    while (*name != '\0') {
+        hash ^= (unsigned char)*name;
+        hash *= 16777619u;
+        name += 1;
+    }
+    return hash & (CACHE_BUCKETS - 1);
+}
+
+/* Copies a string into the cache arena
+
+s - the string to copy
+
+Returns:
+    the copy
+    NULL if out of memory
+*/
+static char *cache_copy(const char *s) {
+    int length = mystrlen(s);
+    char *copy = arena_alloc(&cacheArena, length + 1);
+
+    if (copy != NULL) {
+        mystrcpy(copy, s);
+        copy[length] = '\0';
+    }
+    return copy;
+}
+
+void clear_command_cache() {
+    for (int i = 0; i < CACHE_BUCKETS; i++) {
+        buckets[i] = NULL;
+    }
+    arena_reset(&cacheArena);
+    cachedPath = NULL;
+}
+
+/* Empties the cache if $PATH is not the value the entries were found with
+
+path - the current value of $PATH, or the default when it is unset
+
+No return values
+*/
+static void check_path_changed(const char *path) {
+    if (path == NULL) {
+        path = defaultPath;
+    }
+    if (cachedPath != NULL && mystrcmp(cachedPath, path) == 0) {
+        return;
+    }
+    clear_command_cache();
+    cachedPath = cache_copy(path);
+}
+
+/* Tries each directory of a PATH string in order
+
+path - the colon separated directory list (an empty entry means the current directory)
+name - the command name to look for
+found - filled in with the first executable regular file found
+
+Returns:
+    0 if the command was found in an absolute directory
+    1 if it was found in a relative one (such as . or an empty entry), which depends on the working directory
+    -1 if it was not found
+*/
+static int search_path(const char *path, const char *name, char found[]) {
+    int nameLength = mystrlen(name);
+    struct stat info;
+
+    while (1) {
+        int length = 0;
+
+        while (path[length] != ':' && path[length] != '\0') {
+            length += 1;
+        }
+
+        if (length + nameLength + 2 <= PATH_BUFFER_SIZE) {
+            int pos = 0;
+            if (length == 0) {
+                found[pos++] = '.';
+            }
+            for (int i = 0; i < length; i++) {
+                found[pos++] = path[i];
+            }
+            found[pos++] = '/';
+            mystrcpy(&found[pos], name);
+            found[pos + nameLength] = '\0';
+
+            if (stat(found, &info) == 0 && S_ISREG(info.st_mode) && access(found, X_OK) == 0) {
+                return found[0] == '/' ? 0 : 1;
+            }
+        }
+
+        if (path[length] == '\0') {
+            return -1;
+        }
+        path += length + 1;
+    }
+}
+
+char *find_command(const char *name) {
+    char found[PATH_BUFFER_SIZE];
+    const char *path = env_get("PATH");
+    struct CacheEntry *entry;
+    struct CacheEntry **link;
+    unsigned int bucket;
+    int result;
+
+    // Paths are used as given and never cached
+    for (int i = 0; name[i] != '\0'; i++) {
+        if (name[i] == '/') {
+            return (char *)name;
+        }
+    }
+
+    if (path == NULL) {
+        path = defaultPath;
+    }
+    check_path_changed(path);
+
+    bucket = hash_name(name);
+    for (link = &buckets[bucket]; *link != NULL; link = &(*link)->next) {
+        entry = *link;
+        if (mystrcmp(entry->name, name) != 0) {
+            continue;
+        }
+        // a program removed since it was found is forgotten and searched for again
+        if (access(entry->path, X_OK) != 0) {
+            *link = entry->next;
+            break;
+        }
+        entry->hits += 1;
+        return entry->path;
+    }
+
+    if (name[0] == '\0') {
+        return NULL;
+    }
+    result = search_path(path, name, found);
+    if (result == -1) {
+        return NULL;
+    }
+    // a hit in a relative directory would point elsewhere after cd, so it is searched for every time
+    if (result == 1) {
+        mystrcpy(uncachedPath, found);
+        uncachedPath[mystrlen(found)] = '\0';
+        return uncachedPath;
+    }
+
+    entry = (struct CacheEntry *)arena_alloc(&cacheArena, sizeof(struct CacheEntry));
+    if (entry == NULL) {
+        return NULL;
+    }
+    entry->name = cache_copy(name);
+    entry->path = cache_copy(found);
+    if (entry->name == NULL || entry->path == NULL) {
+        return NULL;
+    }
+    entry->hits = 1;
+    entry->next = buckets[bucket];
+    buckets[bucket] = entry;
+    return entry->path;
+}
+
+int print_command_cache(int out) {
+    char number[20];
+    int count = 0;
+
+    // entries found with an old $PATH are dropped here too, not only at the next lookup
+    check_path_changed(env_get("PATH"));
+    for (int i = 0; i < CACHE_BUCKETS; i++) {
+        for (struct CacheEntry *entry = buckets[i]; entry != NULL; entry = entry->next) {
+            write(out, number, myitoa(entry->hits, number));
+            write(out, "\t", 1);
+            write(out, entry->path, mystrlen(entry->path));
+            write(out, "\n", 1);
+            count += 1;
+        }
+    }
+    return count;
+}
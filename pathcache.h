@@ -0,0 +1,40 @@
+#ifndef PATH_CACHE_H
+#define PATH_CACHE_H
+
+#define CACHE_BUCKETS 256     /* hash table size, must be a power of two */
+
+/* Finds the program a command name refers to. Names containing a '/' are
+used as given, anything else is searched for in each directory of $PATH.
+Found locations are remembered, so later lookups of the same name skip the
+search. The cache is emptied automatically when $PATH changes. Programs
+found through a relative directory of $PATH (such as . or an empty entry)
+are not remembered, since they depend on the working directory. A
+remembered location that can no longer be executed is searched for again.
+
+name - the command name (argv[0])
+
+Returns:
+    the path to execute, valid until the cache is next cleared (until the
+    next call for a program found through a relative directory)
+    NULL if the command was not found
+*/
+char *find_command(const char *name);
+
+/* Forgets every remembered command location (hash -r)
+
+Takes no arguments
+No return values
+*/
+void clear_command_cache();
+
+/* Writes the remembered command locations and how often each was used,
+first forgetting them if $PATH has changed since they were found
+
+out - the file descriptor to write to
+
+Returns:
+    the number of entries written
+*/
+int print_command_cache(int out);
+
+#endif
@@ -0,0 +1,148 @@
+#define _GNU_SOURCE
+#include "pipesize.h"
+#include "mystring.h"
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/resource.h>
+
+#define MIN_SAMPLE_NS 10000000L     /* pipelines shorter than this say too little to adjust on */
+
+static long pipeSize = PIPE_SIZE_DEFAULT;
+static long autoSize = PIPE_SIZE_AUTO_MIN;
+static long maxSize = 0;            /* 0 until read from /proc */
+
+
+int parse_pipe_size(const char *text, long *size) {
+    long value = 0;
+    int i = 0;
+
+    if (mystrcmp(text, "default") == 0) {
+        *size = PIPE_SIZE_DEFAULT;
+        return 0;
+    }
+    if (mystrcmp(text, "auto") == 0) {
+        *size = PIPE_SIZE_AUTO;
+        return 0;
+    }
+    for (; text[i] >= '0' && text[i] <= '9'; i++) {
+        // anything this large is capped anyway, so just stop it overflowing
+        if (value < 1L << 40) {
+            value = value * 10 + (text[i] - '0');
+        }
+    }
+    if (i == 0) {
+        return -1;
+    }
+    if (text[i] == 'k' || text[i] == 'K') {
+        value <<= 10;
+        i += 1;
+    } else if (text[i] == 'm' || text[i] == 'M') {
+        value <<= 20;
+        i += 1;
+    }
+    if (text[i] != '\0' || value <= 0) {
+        return -1;
+    }
+    *size = value;
+    return 0;
+}
+
+void set_pipe_size(long size) {
+    pipeSize = size;
+    autoSize = PIPE_SIZE_AUTO_MIN;
+}
+
+long get_pipe_size() {
+    return pipeSize;
+}
+
+long pipe_max_size() {
+    char text[32];
+    long value = 0;
+    int length;
+    int fd;
+
+    if (maxSize != 0) {
+        return maxSize;
+    }
+    maxSize = PIPE_SIZE_FALLBACK_MAX;
+    fd = open("/proc/sys/fs/pipe-max-size", O_RDONLY | O_CLOEXEC);
+    if (fd == -1) {
+        return maxSize;
+    }
+    length = read(fd, text, sizeof(text) - 1);
+    close(fd);
+    for (int i = 0; i < length && text[i] >= '0' && text[i] <= '9'; i++) {
+        value = value * 10 + (text[i] - '0');
+    }
+    if (value > 0) {
+        maxSize = value;
+    }
+    return maxSize;
+}
+
+long effective_pipe_size() {
+    long size = pipeSize == PIPE_SIZE_AUTO ? autoSize : pipeSize;
+
+    if (size > pipe_max_size()) {
+        size = pipe_max_size();
+    }
+    return size;
+}
+
+void size_pipe(int fd) {
+    long size = effective_pipe_size();
+
+    if (size > 0) {
+        fcntl(fd, F_SETPIPE_SZ, (int)size);
+    }
+}
+
+/* Returns the context switches of every reaped child so far
+
+Takes no arguments
+
+Returns:
+    voluntary plus involuntary context switches
+*/
+static long child_switches() {
+    struct rusage usage;
+
+    getrusage(RUSAGE_CHILDREN, &usage);
+    return usage.ru_nvcsw + usage.ru_nivcsw;
+}
+
+void pipe_sample_start(struct PipeSample *sample) {
+    if (pipeSize != PIPE_SIZE_AUTO) {
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &sample->started);
+    sample->switches = child_switches();
+}
+
+void pipe_sample_finish(struct PipeSample *sample, unsigned int pipes) {
+    struct timespec finished;
+    long elapsed;
+    long rate;
+
+    if (pipeSize != PIPE_SIZE_AUTO || pipes == 0) {
+        return;
+    }
+    clock_gettime(CLOCK_MONOTONIC, &finished);
+    elapsed = (finished.tv_sec - sample->started.tv_sec) * 1000000000L
+              + (finished.tv_nsec - sample->started.tv_nsec);
+    if (elapsed < MIN_SAMPLE_NS) {
+        return;
+    }
+
+    // switches per second for each pipe, from the elapsed milliseconds
+    rate = (child_switches() - sample->switches) * 1000 / (elapsed / 1000000) / pipes;
+    if (rate > PIPE_AUTO_GROW_RATE && autoSize < pipe_max_size()) {
+        autoSize *= 4;
+        if (autoSize > pipe_max_size()) {
+            autoSize = pipe_max_size();
+        }
+    } else if (rate < PIPE_AUTO_SHRINK_RATE && autoSize > PIPE_SIZE_AUTO_MIN) {
+        autoSize /= 2;
+    }
+}
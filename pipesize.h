@@ -0,0 +1,96 @@
+#ifndef PIPE_SIZE_H
+#define PIPE_SIZE_H
+
+#include <time.h>
+
+#define PIPE_SIZE_DEFAULT 0             /* leave pipes at the kernel's default size */
+#define PIPE_SIZE_AUTO -1               /* size pipes from the context switch rate of earlier pipelines */
+#define PIPE_SIZE_FALLBACK_MAX 1048576  /* limit used when /proc/sys/fs/pipe-max-size can't be read */
+#define PIPE_SIZE_AUTO_MIN 65536        /* smallest size auto mode uses, the kernel default */
+#define PIPE_AUTO_GROW_RATE 2000        /* switches per second per pipe above which auto mode grows pipes */
+#define PIPE_AUTO_SHRINK_RATE 200       /* switches per second per pipe below which auto mode shrinks pipes */
+
+/* Start of a pipeline run, used by auto mode to measure it */
+struct PipeSample
+{
+  struct timespec started;      /* CLOCK_MONOTONIC time the pipeline started */
+  long switches;                /* context switches of reaped children so far */
+};
+
+/* Converts "default", "auto", or a byte count with an optional k or m suffix
+
+text - the text to convert
+size - set to PIPE_SIZE_DEFAULT, PIPE_SIZE_AUTO or the number of bytes
+
+Returns:
+    0 if successful
+    -1 if the text is not a valid size
+*/
+int parse_pipe_size(const char *text, long *size);
+
+/* Sets the capacity given to every pipe created for a pipeline from now on
+
+size - PIPE_SIZE_DEFAULT, PIPE_SIZE_AUTO or a number of bytes (capped when applied)
+
+No return values
+*/
+void set_pipe_size(long size);
+
+/* Returns the capacity setting
+
+Takes no arguments
+
+Returns:
+    PIPE_SIZE_DEFAULT, PIPE_SIZE_AUTO or a number of bytes
+*/
+long get_pipe_size();
+
+/* Returns the size pipes are currently given: the set size or the current
+auto mode size, capped at the system limit
+
+Takes no arguments
+
+Returns:
+    the number of bytes
+    0 if pipes are left at the kernel's default
+*/
+long effective_pipe_size();
+
+/* Returns the largest capacity an unprivileged process can give a pipe
+
+Takes no arguments
+
+Returns:
+    the value of /proc/sys/fs/pipe-max-size, read once
+*/
+long pipe_max_size();
+
+/* Gives a new pipe the current capacity with F_SETPIPE_SZ. Failures (such
+as the per-user pipe memory limit) leave the pipe at its old size
+
+fd - either end of the pipe
+
+No return values
+*/
+void size_pipe(int fd);
+
+/* Records the state before a foreground pipeline starts
+
+sample - filled in with the start time and reaped children's context switches
+
+No return values
+*/
+void pipe_sample_start(struct PipeSample *sample);
+
+/* Adjusts the auto mode size once a foreground pipeline has been waited for.
+Frequent context switches mean stages keep blocking on full or empty pipes,
+so pipes grow; rare ones mean the memory is wasted, so they shrink
+
+sample - the sample taken by pipe_sample_start
+pipes - the number of pipes in the pipeline
+
+No return values
+*/
+void pipe_sample_finish(struct PipeSample *sample, unsigned int pipes);
+
+#endif
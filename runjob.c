@@ -1,156 +1,481 @@
+#define _GNU_SOURCE
 #include "runjob.h"
+#include "launch.h"
+#include "pathcache.h"
+#include "builtins.h"
+#include "mystring.h"
+#include "jobtable.h"
+#include "pipesize.h"
+#include "trace.h"
+#include "env.h"
+#include "expand.h"
+#include "datamove.h"
 #include <unistd.h>
 #include <sys/types.h>
-#include <sys/wait.h>
 #include <sys/stat.h>
 #include <fcntl.h>
+#include <limits.h>
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <signal.h>
 
 #define PIPE_READ_END  0
 #define PIPE_WRITE_END 1
 
-const char *forkError = "Error occurred while forking new process\n";
-const char *execveError = "Error occurred while executing program\n";
-const char *waitpidError = "Error occurred while waiting for program\n"; 
 const char *inOpenError = "Error while opening file for input\n";
 const char *outOpenError = "Error while opening file for output\n";
 const char *pipeError = "Error while creating pipes\n";
+const char *stringError = "Error while creating here-document input\n";
+const char *notFoundError = ": command not found\n";
+const char *envError = "Error while processing command: out of memory for environment\n";
+const char *listExpandError = "Error while processing command: out of memory for command\n";
+
+static int lastStatus = 0;
+static int lastInterrupted = 0;                   /* 1 if Ctrl-C ended the most recent job */
+static builtin_function forkedBuiltin = NULL;     /* the builtin a forked stage runs, set before the fork */
+static struct Command *forkedCommand = NULL;      /* the stage it runs, for its VAR=value prefixes */
+static struct Job *forkedList = NULL;             /* the and-or list a forked copy runs in the background */
 
 
 /*
-Helper function to run a command with optional waiting
+Runs a builtin in a forked child in place of a program. The child forgets
+the shell's jobs first, so builtins like wait only see their own children,
+and exports the stage's VAR=value prefixes into its own copy of the variables
 
-command - pointer to Command structure containing the command to execute
-infile - input file descriptor (0 for stdin)
-outfile - output file descriptor (0 for stdout)
-wait - 1 to wait for command completion, 0 for background execution
+Arguments are those of builtin_function
 
 Returns:
-    0 if execution successful
-    -1 if error while forking
-    -2 if error while waiting on new program
+    the exit status of the builtin
 */
-static int run_command(struct Command* command, int infile, int outfile, int wait){
-    pid_t pid;
+static int run_forked_builtin(int argc, char *argv[], int in, int out) {
     int status;
 
-    //fork new proccess
-    pid = fork();
+    jobs_init_child();
+    trace_child();
+    for (unsigned int i = 0; i < forkedCommand->num_assignments; i++) {
+        env_assign(forkedCommand->assignments[i], 1);
+    }
+    status = forkedBuiltin(argc, argv, in, out);
+    // the child leaves with _exit, which skips the flush at exit
+    if (traceEnabled) {
+        trace_flush();
+    }
+    // a copy Ctrl-C ended dies of it too, so the shell can tell it from an exit with 130
+    if (take_move_interrupt()) {
+        signal(SIGINT, SIG_DFL);
+        raise(SIGINT);
+    }
+    return status;
+}
 
-    if (pid == -1) {
-        write(1, forkError, 41);
+/*
+Runs an and-or list ended by & in a forked child, which stands for the whole
+list in the shell's job table. The child forgets the shell's jobs first and
+runs the list in its own foreground, stopping where the & ended it
+
+Arguments are those of builtin_function and are not used
+
+Returns:
+    the status of the list, as last_exit_status gives it
+*/
+static int run_forked_list(int argc, char *argv[], int in, int out) {
+    struct Job *part = forkedList;
+
+    jobs_init_child();
+    trace_child();
+    for (; part->next_if != JOB_THEN; part = part->next) {
+        part->background = 0;
+    }
+    part->background = 0;
+    part->next = NULL;
+    run_job(forkedList);
+    // the child leaves with _exit, which skips the flush at exit
+    if (traceEnabled) {
+        trace_flush();
+    }
+    return lastStatus;
+}
+
+/*
+Helper function to find the program for a stage in $PATH and start it in
+the process group of its job with the exported variables, plus the stage's
+VAR=value prefixes. Builtins are run in a forked copy of the shell
+
+launch - the stage to start, with argv and moves filled in (path, envp, function and process group are set here)
+command - the stage's command, for its prefixes
+entry - job table entry the stage belongs to
+
+Returns:
+    the pid of the new process if successful
+    0 if the command was not found or could not be executed (error already printed)
+    -1 if no process could be created
+*/
+static pid_t start_command(struct Launch* launch, struct Command* command, struct JobEntry* entry) {
+    launch->job_control = job_control_enabled();
+    launch->pgid = entry->pgid;
+    launch->foreground = entry->foreground;
+    launch->function = NULL;
+
+    forkedBuiltin = find_builtin(launch->argv[0]);
+    if (forkedBuiltin != NULL) {
+        forkedCommand = command;
+        launch->function = run_forked_builtin;
+        for (launch->argc = 0; launch->argv[launch->argc] != NULL; launch->argc++) {}
+        return launch_command(launch);
+    }
+
+    launch->path = find_command(launch->argv[0]);
+    if (launch->path == NULL) {
+        write(1, launch->argv[0], mystrlen(launch->argv[0]));
+        write(1, notFoundError, 20);
+        return 0;
+    }
+    // the shared array is reused until a variable changes, only prefixes need a new one
+    if (command->num_assignments == 0) {
+        launch->envp = env_envp();
+    } else {
+        launch->envp = env_envp_with(command->assignments, command->num_assignments);
+    }
+    if (launch->envp == NULL) {
+        write(1, envError, 62);
+        return -1;
+    }
+    return launch_command(launch);
+}
+
+/*
+Helper function to put a here-string or here-document in an fd the command
+can read: a pipe when it fits in one without blocking, otherwise a memfd,
+which never needs a writer running alongside the command
+
+text - the text
+newline - 1 to add a newline after the text (here-strings)
+
+Returns:
+    a close-on-exec fd positioned at the start of the text
+    -1 if the fd could not be created or filled
+*/
+static int open_string(const char* text, int newline) {
+    struct iovec parts[2] = {{(void *)text, mystrlen(text)}, {"\n", newline}};
+    ssize_t length = parts[0].iov_len + newline;
+    int fds[2];
+    int fd;
+
+    if (length <= PIPE_BUF) {
+        if (pipe2(fds, O_CLOEXEC) == -1) {
+            return -1;
+        }
+        // an empty pipe takes up to PIPE_BUF bytes in one write
+        writev(fds[PIPE_WRITE_END], parts, 2);
+        close(fds[PIPE_WRITE_END]);
+        return fds[PIPE_READ_END];
+    }
+    fd = memfd_create("mysh-here-document", MFD_CLOEXEC);
+    if (fd == -1) {
         return -1;
     }
+    if (writev(fd, parts, 2) != length || lseek(fd, 0, SEEK_SET) != 0) {
+        close(fd);
+        return -1;
+    }
+    return fd;
+}
+
+/*
+Helper function to close the fds opened for a job's redirections
+
+opened - the fds, -1 for redirections that opened nothing
+count - the number of entries in opened
 
-    if (pid == 0) {
-        //in child
-        if (infile != 0) {
-            dup2(infile, 0);
-            close(infile);
+No return values
+*/
+static void close_redirections(int* opened, unsigned int count) {
+    for (unsigned int i = 0; i < count; i++) {
+        if (opened[i] != -1) {
+            close(opened[i]);
         }
-        if (outfile != 0) {
-            dup2(outfile, 1);
-            close(outfile);
+    }
+}
+
+/*
+Helper function to find the highest fd named anywhere in a job's redirections,
+as a target or as the source of a duplication. Fds the shell opens for the job
+are kept above it, so a redirection can only reach the fds it was meant to
+
+job - pointer to Job structure containing the redirections
+
+Returns:
+    the highest fd named, at least 2
+*/
+static int highest_named_fd(struct Job* job) {
+    int highest = 2;
+
+    for (unsigned int i = 0; i < job->num_stages; i++) {
+        for (unsigned int j = 0; j < job->pipeline[i].num_redirections; j++) {
+            struct Redirection *redirection = &job->pipeline[i].redirections[j];
+            if (redirection->fd > highest) highest = redirection->fd;
+            if (redirection->source > highest) highest = redirection->source;
         }
-        execve(command->argv[0], command->argv, NULL);
-        write(1, execveError, 39);
-        _exit(2);
-    }
-
-    if (pid != 0) {
-        //in parent
-        if (wait == 1) {
-            pid = waitpid(pid, &status, 0);
-            if (pid == -1) {
-                write(1, waitpidError, 41);
-                return -2;
+    }
+    return highest;
+}
+
+/*
+Helper function to open the files, here-strings and here-documents of every
+redirection of a job, stage by stage in the order written. All are
+close-on-exec, so only the stage they are moved onto keeps them. An fd that
+could be mistaken for one a redirection names is moved above it, since moves
+are applied in order
+
+job - pointer to Job structure containing the redirections
+opened - filled with one fd per redirection of the job, -1 for REDIRECT_DUP
+
+Returns:
+    0 if everything opened successfully
+    -3 if error opening an input file, here-string or here-document (nothing is left open)
+    -4 if error opening an output file (nothing is left open)
+*/
+static int open_redirections(struct Job* job, int* opened) {
+    unsigned int count = 0;
+    int highest = highest_named_fd(job);
+
+    for (unsigned int i = 0; i < job->num_stages; i++) {
+        for (unsigned int j = 0; j < job->pipeline[i].num_redirections; j++) {
+            struct Redirection *redirection = &job->pipeline[i].redirections[j];
+            int fd = -1;
+
+            switch (redirection->type) {
+                case REDIRECT_INPUT:
+                    fd = open(redirection->word, O_RDONLY | O_CLOEXEC);
+                    break;
+                case REDIRECT_OUTPUT:
+                    fd = open(redirection->word, O_WRONLY | O_CREAT | O_TRUNC | O_CLOEXEC, S_IRUSR | S_IWUSR);
+                    break;
+                case REDIRECT_APPEND:
+                    fd = open(redirection->word, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, S_IRUSR | S_IWUSR);
+                    break;
+                case REDIRECT_STRING:
+                case REDIRECT_HEREDOC:
+                    fd = open_string(redirection->word, redirection->type == REDIRECT_STRING);
+                    break;
+                default:
+                    opened[count++] = -1;
+                    continue;
+            }
+            if (fd != -1 && fd <= highest) {
+                int moved = fcntl(fd, F_DUPFD_CLOEXEC, highest + 1);
+                close(fd);
+                fd = moved;
+            }
+            if (fd == -1) {
+                close_redirections(opened, count);
+                if (redirection->type == REDIRECT_STRING || redirection->type == REDIRECT_HEREDOC) {
+                    write(1, stringError, 41);
+                    return -3;
+                }
+                if (redirection->type == REDIRECT_INPUT) {
+                    write(1, inOpenError, 35);
+                    return -3;
+                }
+                write(1, outOpenError, 36);
+                return -4;
             }
+            opened[count++] = fd;
         }
-        
-        return 0;
     }
+    return 0;
 }
 
 /*
-Helper function to run a command without forking (used in pipeline children)
+Helper function to add the moves of a command's redirections to a launch,
+after any it already has
 
-command - pointer to Command structure containing the command to execute
-infile - input file descriptor (0 for stdin)
-outfile - output file descriptor (0 for stdout)
+command - the command whose redirections are added
+opened - the fds open_redirections opened for the command's redirections
+launch - the launch to add to, with room for num_redirections more moves
+
+No return values
+*/
+static void add_redirection_moves(struct Command* command, int* opened, struct Launch* launch) {
+    for (unsigned int i = 0; i < command->num_redirections; i++) {
+        struct Redirection *redirection = &command->redirections[i];
+        int source = redirection->type == REDIRECT_DUP ? redirection->source : opened[i];
+
+        launch->moves[launch->num_moves++] = (struct FdMove){redirection->fd, source};
+    }
+}
+
+/*
+Helper function to find the fds a stage run inside the shell uses as its
+input and output, by following its moves in order as the new process would
+
+launch - the stage's moves
+in - set to the fd that ends up as fd 0
+out - set to the fd that ends up as fd 1
+
+No return values
+*/
+static void find_in_out(struct Launch* launch, int* in, int* out) {
+    int fds[REDIRECT_MOST_FD + 1];
+
+    for (int i = 0; i <= REDIRECT_MOST_FD; i++) {
+        fds[i] = i;
+    }
+    // targets never go past REDIRECT_MOST_FD, and higher sources are fds the shell opened for the job
+    for (unsigned int i = 0; i < launch->num_moves; i++) {
+        int source = launch->moves[i].source;
+        fds[launch->moves[i].target] = source <= REDIRECT_MOST_FD ? fds[source] : source;
+    }
+    *in = fds[0];
+    *out = fds[1];
+}
+
+/*
+Helper function to start a single-stage job, recording its process in the job table
+
+job - pointer to Job structure containing the command to execute
+opened - the fds opened for the command's redirections (see open_redirections)
+entry - job table entry the stage is recorded in
+
+Returns:
+    0 if the stage was started, or recorded as not executed
+    -1 if error while forking (the entry has been freed)
+*/
+static int run_command(struct Job* job, int* opened, struct JobEntry* entry){
+    struct FdMove moves[job->pipeline[0].num_redirections + 1];
+    struct Launch launch = {NULL, job->pipeline[0].argv, NULL, moves, 0, 0, 0, 0, NULL, 0};
+    pid_t pid;
+
+    add_redirection_moves(&job->pipeline[0], opened, &launch);
+
+    pid = start_command(&launch, &job->pipeline[0], entry);
+    if (pid == -1) {
+        wait_for_job(entry);
+        return -1;
+    }
+    // pid is 0 when the program could not be executed, the entry records that
+    job_add_process(entry, pid);
+    return 0;
+}
+
+/*
+Helper function to run a single-stage builtin command inside the shell, with
+the redirected fds 0 and 1 as its input and output
+
+job - pointer to Job structure containing the command and its redirections
+builtin - the function implementing the command
 
 Returns:
-    void (exits child process via execve or _exit)
+    0 if execution successful
+    -3 if error opening an input file, here-string or here-document
+    -4 if error opening an output file
 */
-static void run_command_no_fork(struct Command* command, int infile, int outfile) {
-    if (infile != 0) {
-        dup2(infile, 0);
-        close(infile);
-    }
-    if (outfile != 0) {
-        dup2(outfile, 1);
-        close(outfile);
-    }
-    execve(command->argv[0], command->argv, NULL);
-    write(1, execveError, 39);
-    _exit(2);
+static int run_builtin_job(struct Job* job, builtin_function builtin) {
+    unsigned int count = job->pipeline[0].num_redirections;
+    int opened[count + 1];
+    struct FdMove moves[count + 1];
+    struct Launch launch = {NULL, NULL, NULL, moves, 0, 0, 0, 0, NULL, 0};
+    int in;
+    int out;
+    int result;
+
+    result = open_redirections(job, opened);
+    if (result != 0) {
+        return result;
+    }
+    add_redirection_moves(&job->pipeline[0], opened, &launch);
+    find_in_out(&launch, &in, &out);
+
+    lastStatus = builtin(job->pipeline[0].argc, job->pipeline[0].argv, in, out);
+
+    close_redirections(opened, count);
+    return 0;
 }
 
 /*
-Helper function to handle single-stage job execution with file I/O redirection
+Helper function to start a single-stage job with its redirections
 
-job - pointer to Job structure containing the command and I/O redirection info
+job - pointer to Job structure containing the command and its redirections
+foreground - 1 if the shell will wait for the job
+started - set to the job table entry of the job
 
 Returns:
     0 if execution successful
     -1 if error while forking (from run_command)
-    -2 if error while waiting for program (from run_command, foreground jobs only)
-    -3 if error opening input file
-    -4 if error opening output file
+    -2 if the job table is full
+    -3 if error opening an input file, here-string or here-document
+    -4 if error opening an output file
 */
-static int run_single_stage_job(struct Job* job) {
-    int in = 0;
-    int out = 0;
-    int should_wait = 1;
-    
-    if (job->infile_path != NULL) {
-        in = open(job->infile_path, O_RDONLY);
-        if (in == -1) {
-            write(1, inOpenError, 35);
-            return -3;
-        }
+static int start_single_stage_job(struct Job* job, int foreground, struct JobEntry** started) {
+    unsigned int count = job->pipeline[0].num_redirections;
+    int opened[count + 1];
+    int result;
+    struct JobEntry *entry;
+
+    result = open_redirections(job, opened);
+    if (result != 0) {
+        return result;
     }
-    if (job->outfile_path != NULL) {
-        out = open(job->outfile_path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
-        if (out == -1) {
-            write(1, outOpenError, 36);
-            if (in != 0) close(in);
-            return -4;
+
+    entry = create_job(job);
+    if (entry == NULL) {
+        result = -2;
+    } else {
+        if (foreground) {
+            foreground_job(entry);
         }
+        result = run_command(job, opened, entry);
+        *started = entry;
     }
-    
-    if (job->background) {
-        should_wait = 0;
-    }
-    int result = run_command(&job->pipeline[0], in, out, should_wait);
 
-    if (in != 0) close(in);
-    if (out != 0) close(out);
+    close_redirections(opened, count);
     
     return result;
 }
 
 /*
-Helper function to create pipes for pipeline communication
+Helper function to move both ends of a new pipe above the fds a job's
+redirections name. The ends stay close-on-exec
+
+ends - the pipe's two fds, updated in place
+highest - highest fd the job's redirections name
+
+Returns:
+    0 if successful
+    -1 if an end could not be moved (both ends are closed)
+*/
+static int move_above(int ends[2], int highest) {
+    for (int i = 0; i < 2; i++) {
+        if (ends[i] <= highest) {
+            int moved = fcntl(ends[i], F_DUPFD_CLOEXEC, highest + 1);
+            close(ends[i]);
+            ends[i] = moved;
+        }
+    }
+    if (ends[0] == -1 || ends[1] == -1) {
+        close(ends[0]);
+        close(ends[1]);
+        return -1;
+    }
+    return 0;
+}
+
+/*
+Helper function to create pipes for pipeline communication. Both ends are
+close-on-exec, so children only keep the ends moved onto their stdin/stdout.
+Each pipe is given the capacity chosen with the pipesize builtin
 
 numberOfPipes - number of pipes to create (num_stages - 1)
 pipes - 2D array to store pipe file descriptors
+highest - highest fd the job's redirections name, pipe ends are kept above it
 
 Returns:
     0 if all pipes created successfully
     -1 if error creating pipes (closes any already created pipes)
 */
-static int create_pipes(int numberOfPipes, int pipes[][2]) {
+static int create_pipes(int numberOfPipes, int pipes[][2], int highest) {
     for (int i = 0; i < numberOfPipes; i++) {
-        if (pipe(pipes[i]) == -1) {
+        if (pipe2(pipes[i], O_CLOEXEC) == -1 || move_above(pipes[i], highest) != 0) {
             write(1, pipeError, 27);
             // Close already created pipes
             for (int j = 0; j < i; j++) {
@@ -159,6 +484,7 @@ static int create_pipes(int numberOfPipes, int pipes[][2]) {
             }
             return -1;
         }
+        size_pipe(pipes[i][PIPE_WRITE_END]);
     }
     return 0;
 }
@@ -180,211 +506,462 @@ static void close_all_pipes(int numberOfPipes, int pipes[][2]) {
 }
 
 /*
-Helper function to setup and run first command in pipeline (runs in child process)
+Helper function to describe the first command in a pipeline
 
-job - pointer to Job structure containing command and I/O redirection info
+job - pointer to Job structure containing the command
 pipes - 2D array containing pipe file descriptors
-numberOfPipes - number of pipes in the pipeline
+launch - filled in with the program and pipe moves for the stage (needs room for 1 move)
 
 Returns:
-    void (child proccess becomes first command during function)
+    void
 */
-static void setup_first_command(struct Job* job, int pipes[][2], int numberOfPipes) {
-    int in = 0;
-    int out = 0;
-    
-    if (job->infile_path != NULL) {
-        in = open(job->infile_path, O_RDONLY);
-        if (in == -1) {
-            write(1, inOpenError, 35);
-            _exit(1);
-        }
-    }
+static void setup_first_command(struct Job* job, int pipes[][2], struct Launch* launch) {
+    launch->argv = job->pipeline[0].argv;
+    launch->num_moves = 0;
 
     // out is first pipe write
-    out = pipes[0][PIPE_WRITE_END];
-
-    // close all other pipes
-    close(pipes[0][PIPE_READ_END]);
-    for (int j = 1; j < numberOfPipes; j++) {
-        close(pipes[j][PIPE_READ_END]);
-        close(pipes[j][PIPE_WRITE_END]);
-    }
-
-    run_command_no_fork(&job->pipeline[0], in, out);
+    launch->moves[launch->num_moves++] = (struct FdMove){1, pipes[0][PIPE_WRITE_END]};
 }
 
 /*
-Helper function to setup and run last command in pipeline (runs in child process)
+Helper function to describe the last command in a pipeline
 
-job - pointer to Job structure containing command and I/O redirection info
+job - pointer to Job structure containing the command
 pipes - 2D array containing pipe file descriptors
 numberOfPipes - number of pipes in the pipeline
-stage_index - index of the command in the pipeline
+launch - filled in with the program and pipe moves for the stage (needs room for 1 move)
 
 Returns:
-    void (child proccess becomes last command during function)
+    void
 */
-static void setup_last_command(struct Job* job, int pipes[][2], int numberOfPipes, int stage_index) {
-    int in = 0;
-    int out = 0;
-    
-    if (job->outfile_path != NULL) {
-        out = open(job->outfile_path, O_WRONLY | O_CREAT | O_TRUNC, S_IRUSR | S_IWUSR);
-        if (out == -1) {
-            write(1, outOpenError, 36);
-            _exit(2);
-        }
-    }
+static void setup_last_command(struct Job* job, int pipes[][2], int numberOfPipes, struct Launch* launch) {
+    launch->argv = job->pipeline[numberOfPipes].argv;
+    launch->num_moves = 0;
 
     // in is last pipe read
-    in = pipes[numberOfPipes - 1][PIPE_READ_END];
-    
-    // close all other pipes
-    close(pipes[numberOfPipes - 1][PIPE_WRITE_END]);
-    for (int j = 0; j < numberOfPipes - 1; j++) {
-        close(pipes[j][PIPE_READ_END]);
-        close(pipes[j][PIPE_WRITE_END]);
-    }
-    
-    run_command_no_fork(&job->pipeline[stage_index], in, out);
+    launch->moves[launch->num_moves++] = (struct FdMove){0, pipes[numberOfPipes - 1][PIPE_READ_END]};
 }
 
 /*
-Helper function to setup and run middle commands in pipeline (runs in child process)
+Helper function to describe a middle command in a pipeline
 
-job - pointer to Job structure containing command and I/O redirection info
+job - pointer to Job structure containing the command
 pipes - 2D array containing pipe file descriptors
-numberOfPipes - number of pipes in the pipeline
 stage_index - index of the command in the pipeline
+launch - filled in with the program and pipe moves for the stage (needs room for 2 moves)
 
 Returns:
-    void (child proccess becomes specified middle command during function)
+    void
 */
-static void setup_middle_command(struct Job* job, int pipes[][2], int numberOfPipes, int stage_index) {
+static void setup_middle_command(struct Job* job, int pipes[][2], int stage_index, struct Launch* launch) {
+    launch->argv = job->pipeline[stage_index].argv;
+    launch->num_moves = 0;
+
     //in and out are both pipes
-    int in = pipes[stage_index - 1][PIPE_READ_END];
-    int out = pipes[stage_index][PIPE_WRITE_END];
+    launch->moves[launch->num_moves++] = (struct FdMove){0, pipes[stage_index - 1][PIPE_READ_END]};
+    launch->moves[launch->num_moves++] = (struct FdMove){1, pipes[stage_index][PIPE_WRITE_END]};
+}
 
-    // close all other pipes
-    for (int j = 0; j < stage_index - 1; j++) {
-        close(pipes[j][PIPE_READ_END]);
-        close(pipes[j][PIPE_WRITE_END]);
+/*
+Helper function to choose the stage of a pipeline the shell runs itself: a
+data moving or output only builtin in the last stage, or else a data moving
+builtin in the first. Only foreground
+jobs without job control qualify, since a stage run by the shell can't be
+stopped or moved to the background
+
+job - pointer to Job structure containing the commands
+foreground - 1 if the shell will wait for the job
+mover - set to the builtin to run if a stage is chosen
+
+Returns:
+    the index of the chosen stage
+    -1 if every stage runs in its own process
+*/
+static int choose_shell_stage(struct Job* job, int foreground, builtin_function* mover) {
+    int last = job->num_stages - 1;
+
+    if (!foreground || job_control_enabled()) {
+        return -1;
     }
-    close(pipes[stage_index - 1][PIPE_WRITE_END]);
-    close(pipes[stage_index][PIPE_READ_END]);
-    for (int j = stage_index + 1; j < numberOfPipes; j++) {
-        close(pipes[j][PIPE_READ_END]);
-        close(pipes[j][PIPE_WRITE_END]);
+    // VAR=value prefixes are only exported by a forked stage
+    *mover = find_pipeline_builtin(job->pipeline[last].argv[0]);
+    if (*mover != NULL && job->pipeline[last].num_assignments == 0) {
+        return last;
     }
-
-    run_command_no_fork(&job->pipeline[stage_index], in, out);
+    *mover = find_data_mover(job->pipeline[0].argv[0]);
+    if (*mover != NULL && job->pipeline[0].num_assignments == 0) {
+        return 0;
+    }
+    return -1;
 }
 
 /*
-Helper function to execute pipeline stages by forking child processes
+Helper function to run the stage of a pipeline chosen by choose_shell_stage
+once every other stage has started. Pipe ends the stage does not use are
+closed first so it sees end of input when the stage before it exits, and
+the ones it does use once it is done
 
-job - pointer to Job structure containing commands and I/O redirection info
+job - pointer to Job structure containing the commands
 pipes - 2D array containing pipe file descriptors
 numberOfPipes - number of pipes in the pipeline
-pids - array to store child process IDs
+stage - index of the stage to run
+mover - the builtin implementing the stage
+launch - the stage's fd moves, as filled in by the setup functions and its redirections
+entry - job table entry the stage's status is recorded in
 
 Returns:
-    0 if all stages forked successfully
-    -1 if a fork failed (cleans up pipes and waits for already started children)
+    void
 */
-static int execute_pipeline(struct Job* job, int pipes[][2], int numberOfPipes, pid_t pids[]) {
-    // Loop through each command and run it(can't wait for child commands until whole job is running)
-    for (int i = 0; i < job->num_stages; i++) {
-        pids[i] = fork();
-
-        if (pids[i] == 0) { // in child
-            if (i == 0) { // first command in pipeline
-                setup_first_command(job, pipes, numberOfPipes);
-            }
-            else if (i == job->num_stages - 1) { // last command in pipeline
-                setup_last_command(job, pipes, numberOfPipes, i);
+static void run_shell_stage(struct Job* job, int pipes[][2], int numberOfPipes, int stage,
+                            builtin_function mover, struct Launch* launch, struct JobEntry* entry) {
+    int in;
+    int out;
+
+    find_in_out(launch, &in, &out);
+    for (int i = 0; i < numberOfPipes; i++) {
+        for (int end = PIPE_READ_END; end <= PIPE_WRITE_END; end++) {
+            if (pipes[i][end] != in && pipes[i][end] != out) {
+                close(pipes[i][end]);
             }
-            else { // all commands between first and last
-                setup_middle_command(job, pipes, numberOfPipes, i);
+        }
+    }
+
+    job_set_status(entry, stage, mover(job->pipeline[stage].argc, job->pipeline[stage].argv, in, out));
+
+    // the redirected files belong to the caller, only the pipe ends are closed here
+    for (int i = 0; i < numberOfPipes; i++) {
+        for (int end = PIPE_READ_END; end <= PIPE_WRITE_END; end++) {
+            if (pipes[i][end] == in || pipes[i][end] == out) {
+                close(pipes[i][end]);
             }
         }
+    }
+}
+
+/*
+Helper function to start every stage of a pipeline using the current launch mode.
+A data moving builtin may run inside the shell once the other stages have started
 
-        else if (pids[i] < 0) { // fork failed in parent
-            write(1, forkError, 41);
+job - pointer to Job structure containing commands and their redirections
+pipes - 2D array containing pipe file descriptors
+numberOfPipes - number of pipes in the pipeline
+opened - the fds opened for the job's redirections (see open_redirections)
+foreground - 1 if the shell will wait for the job
+entry - job table entry each started stage is recorded in
+
+Returns:
+    0 if all stages started successfully
+    -1 if a process could not be created (cleans up pipes and waits for already started children)
+*/
+static int execute_pipeline(struct Job* job, int pipes[][2], int numberOfPipes, int* opened, int foreground, struct JobEntry* entry) {
+    unsigned int most = 0;
+    for (unsigned int i = 0; i < job->num_stages; i++) {
+        if (job->pipeline[i].num_redirections > most) {
+            most = job->pipeline[i].num_redirections;
+        }
+    }
+    struct FdMove moves[2 + most];
+    struct FdMove shellMoves[2 + most];
+    struct Launch launch = {NULL, NULL, NULL, moves, 0, 0, 0, 0, NULL, 0};
+    struct Launch shellLaunch = {NULL, NULL, NULL, shellMoves, 0, 0, 0, 0, NULL, 0};
+    builtin_function mover = NULL;
+    // a timed job needs every stage in its own process to measure it
+    int shellStage = choose_shell_stage(job, foreground && !job->timed, &mover);
+    pid_t pid;
+
+    // Start each command (can't wait for child commands until whole job is running)
+    for (unsigned int i = 0; i < job->num_stages; i++) {
+        struct Launch *stage = (int)i == shellStage ? &shellLaunch : &launch;
+
+        if (i == 0) { // first command in pipeline
+            setup_first_command(job, pipes, stage);
+        }
+        else if (i == job->num_stages - 1) { // last command in pipeline
+            setup_last_command(job, pipes, numberOfPipes, stage);
+        }
+        else { // all commands between first and last
+            setup_middle_command(job, pipes, i, stage);
+        }
+        // redirections come after the pipes, so they win over them
+        add_redirection_moves(&job->pipeline[i], opened, stage);
+        opened += job->pipeline[i].num_redirections;
+
+        if ((int)i == shellStage) {
+            // holds the stage's place until the shell has run it
+            job_add_process(entry, 0);
+            continue;
+        }
+        pid = start_command(&launch, &job->pipeline[i], entry);
+        if (pid < 0) {
             // close all pipes
             close_all_pipes(numberOfPipes, pipes);
             // wait for already started children to avoid zombies
-            for (int k = 0; k < i; k++) {
-                int status;
-                waitpid(pids[k], &status, 0);
-            }
+            wait_for_job(entry);
             return -1;
         }
+        job_add_process(entry, pid);
     }
 
-    close_all_pipes(numberOfPipes, pipes);
+    if (shellStage != -1) {
+        run_shell_stage(job, pipes, numberOfPipes, shellStage, mover, &shellLaunch, entry);
+    } else {
+        close_all_pipes(numberOfPipes, pipes);
+    }
     
     return 0;
 }
 
 /*
-Helper function to wait for all child processes to complete
+Helper function to start every stage of a multi-stage pipeline
 
-pids - array of child process IDs
-num_stages - number of child processes to wait for
+job - pointer to Job structure containing job to execute
+foreground - 1 if the shell will wait for the job
+started - set to the job table entry of the job
 
 Returns:
-    0 if all children handled successfully
-    -1 if waitpid error occurred
+    0 if execution successful
+    -3 if error opening an input file, here-string or here-document
+    -4 if error opening an output file
+    -5 if error while creating pipes
+    -6 if a process could not be created
+    -7 if the job table is full
 */
-static int wait_for_children(pid_t pids[], int num_stages) {
-    int status;
+static int start_pipeline_job(struct Job* job, int foreground, struct JobEntry** started) {
+    int numberOfPipes = job->num_stages - 1;
+    int pipes[numberOfPipes][2];
+    unsigned int count = 0;
+    struct JobEntry *entry;
+    int result;
 
-    for (int i = 0; i < num_stages; i++) {
-        pid_t result = waitpid(pids[i], &status, 0);
-        if (result == -1) {
-            write(1, waitpidError, 41);
-            return -1;
-        }
+    for (unsigned int i = 0; i < job->num_stages; i++) {
+        count += job->pipeline[i].num_redirections;
     }
-    return 0;
-}
+    int opened[count + 1];
 
-int run_job(struct Job* job) {
-    if (job->num_stages == 1) {
-        return run_single_stage_job(job);
+    result = open_redirections(job, opened);
+    if (result != 0) {
+        return result;
     }
     
-    // Multi-stage pipeline
-    int numberOfPipes = job->num_stages - 1;
-    int pipes[numberOfPipes][2];
-    pid_t pids[job->num_stages];
-    
     // Create pipes
-    if (create_pipes(numberOfPipes, pipes) != 0) {
+    if (create_pipes(numberOfPipes, pipes, highest_named_fd(job)) != 0) {
+        close_redirections(opened, count);
         return -5;
     }
+
+    entry = create_job(job);
+    if (entry == NULL) {
+        close_all_pipes(numberOfPipes, pipes);
+        close_redirections(opened, count);
+        return -7;
+    }
+    if (foreground) {
+        foreground_job(entry);
+    }
     
     // Execute pipeline
-    int result = execute_pipeline(job, pipes, numberOfPipes, pids);
+    result = execute_pipeline(job, pipes, numberOfPipes, opened, foreground, entry);
+    close_redirections(opened, count);
     if (result != 0) {
         return -6;
     }
+    *started = entry;
+    return 0;
+}
+
+int start_job(struct Job* job, int foreground, struct JobEntry** started) {
+    if (job->num_stages == 1) {
+        return start_single_stage_job(job, foreground, started);
+    }
+    return start_pipeline_job(job, foreground, started);
+}
+
+/*
+Helper function to run a command with no words left, either a line of
+assignments or a command name that expanded to nothing. Its redirections
+are still carried out, so $EMPTY > out creates out, and then its
+assignments set shell variables, exported ones staying exported
+
+job - pointer to Job structure containing the single command
+
+Returns:
+    0 if successful
+    -3 if error opening an input file, here-string or here-document
+    -4 if error opening an output file
+*/
+static int run_empty_command(struct Job* job) {
+    unsigned int count = job->pipeline[0].num_redirections;
+    int opened[count + 1];
+    int result;
+
+    if (count > 0) {
+        result = open_redirections(job, opened);
+        if (result != 0) {
+            return result;
+        }
+        close_redirections(opened, count);
+    }
+    lastStatus = 0;
+    for (unsigned int i = 0; i < job->pipeline[0].num_assignments; i++) {
+        if (env_assign(job->pipeline[0].assignments[i], 0) != 0) {
+            write(1, envError, 62);
+            lastStatus = 1;
+        }
+    }
+    return 0;
+}
+
+/*
+Helper function to run a job of any length and wait for it when in the foreground.
+Single-stage foreground builtin commands run inside the shell unless timed
+
+job - pointer to Job structure containing job to execute
+
+Returns:
+    1 if the job was waited for, which recorded its result
+    otherwise the same values as run_job
+*/
+static int run_pipeline_job(struct Job* job) {
+    struct JobEntry *entry;
+    struct PipeSample sample;
+    builtin_function builtin;
+    int result;
+
+    // blank lines have nothing to run
+    if (job->num_stages == 0) {
+        lastStatus = 0;
+        return 0;
+    }
+    // a line of assignments, or a command that expanded to no words at all
+    if (job->pipeline[0].argc == 0) {
+        return run_empty_command(job);
+    }
+    // a builtin run with & is forked like a program, and so is a timed one or one with prefixes
+    if (job->num_stages == 1 && !job->background && !job->timed && job->pipeline[0].num_assignments == 0) {
+        builtin = find_builtin(job->pipeline[0].argv[0]);
+        if (builtin != NULL) {
+            return run_builtin_job(job, builtin);
+        }
+    }
+
+    pipe_sample_start(&sample);
+    result = start_job(job, !job->background, &entry);
+    if (result != 0) {
+        return result;
+    }
     
     // Wait for all children (only if not background job)
+    lastStatus = 0;
     if (!job->background) {
-        result = wait_for_children(pids, job->num_stages);
-        if (result != 0) {
-            return -7;
+        lastStatus = wait_for_job(entry);
+        // foreground pipelines tune the automatic pipe size
+        pipe_sample_finish(&sample, job->num_stages - 1);
+        if (job->timed) {
+            print_job_usage(1, last_job_result());
         }
-    }  
-    
+        return 1;
+    }
+    background_job(entry);
     return 0;
 }
 
-void check_for_zombies() {
-    int status;
+/*
+Helper function to start an and-or list ended by & in a forked copy of the
+shell, recorded in the job table as one background job
+
+job - the first job of the list
 
-    while (waitpid(-1, &status, WNOHANG) > 0) {} 
-}
\ No newline at end of file
+Returns:
+    0 if the list was started
+    -1 if error while forking
+    -2 if the job table is full
+*/
+static int start_background_list(struct Job* job) {
+    struct Launch launch = {NULL, NULL, NULL, NULL, 0, 0, 0, 0, run_forked_list, 0};
+    struct JobEntry *entry = create_job(job);
+    pid_t pid;
+
+    if (entry == NULL) {
+        return -2;
+    }
+    launch.job_control = job_control_enabled();
+    launch.pgid = entry->pgid;
+    forkedList = job;
+    pid = launch_command(&launch);
+    if (pid == -1) {
+        wait_for_job(entry);
+        return -1;
+    }
+    job_add_process(entry, pid);
+    background_job(entry);
+    lastStatus = 0;
+    return 0;
+}
+
+/*
+Helper function to run one job of a list and record its result
+
+job - pointer to Job structure containing job to execute
+
+Returns:
+    the same values as run_job
+*/
+static int run_listed_job(struct Job* job) {
+    long traceStart = TRACE_START();
+    int result;
+
+    if (job->background && job->next_if != JOB_THEN) {
+        result = start_background_list(job);
+    } else {
+        result = run_pipeline_job(job);
+    }
+
+    TRACE_SPAN(TRACE_JOB, traceStart, job->num_stages);
+
+    // wait_for_job recorded the result of a foreground job itself
+    if (result == 1) {
+        lastInterrupted = last_job_result()->interrupted || take_move_interrupt();
+        return 0;
+    }
+    // Errors inside the shell count as a failed job
+    if (result < 0) {
+        lastStatus = 1;
+    }
+    set_job_result(lastStatus);
+    // a builtin run in the shell catches Ctrl-C itself while it copies
+    lastInterrupted = take_move_interrupt();
+    return result;
+}
+
+int run_job(struct Job* job) {
+    int result = run_listed_job(job);
+
+    for (; job->next != NULL; job = job->next) {
+        // the rest of an and-or list run with & is left to the copy of the shell running it
+        if (job->background && job->next_if != JOB_THEN) {
+            continue;
+        }
+        // Ctrl-C ends the whole line, not just the job it interrupted
+        if (lastInterrupted) {
+            break;
+        }
+        // a skipped job leaves the status alone for the separator after it
+        if ((job->next_if == JOB_AND && lastStatus != 0) || (job->next_if == JOB_OR && lastStatus == 0)) {
+            continue;
+        }
+        // each job is expanded once the jobs before it have run, so it sees their variables and files
+        if (expand_job(job->next) != 0) {
+            write(1, listExpandError, 58);
+            lastStatus = 1;
+            set_job_result(lastStatus);
+            result = -8;
+            continue;
+        }
+        result = run_listed_job(job->next);
+    }
+    return result;
+}
+
+int last_exit_status() {
+    return lastStatus;
+}
@@ -2,35 +2,65 @@
 #define RUNJOB_H
 
 #include "jobs.h"
+#include "jobtable.h"
 
 /*
-Runs given job with support for multi-stage pipelines, I/O redirection, and background jobs
+Runs given job with support for multi-stage pipelines, redirections of any fd in
+any stage, and background jobs. The jobs listed after it run in turn, each
+expanded just before it runs, skipping any that && or || rule out. A job
+killed with SIGINT ends the list. An and-or list ended by & runs in a forked
+copy of the shell, which is one background job
 
 job - pointer to Job structure containing job to execute
 
-Return:
+Return (for the last job that ran):
     0 if successful
 
-    -1 through -4 for single-stage pipelines
-    -1 if error while forking (from run_command)
-    -2 if error while waiting for program (from run_command, foreground jobs only)
-    -3 if error opening input file
-    -4 if error opening output file
+    -1 and -2 for single-stage pipelines and and-or lists run with &
+    -1 if error while forking
+    -2 if the job table is full
+
+    -3 and -4 for any job
+    -3 if error opening an input file, here-string or here-document
+    -4 if error opening an output file
 
     -5 through -7 for multi-stage pipelines
     -5 if error while creating pipes
-    -6 if error while executing pipelines (a fork failed)
-    -7 if error while waiting for children proccesses (only in foreground execution)
+    -6 if error while executing pipelines (a process could not be created)
+    -7 if the job table is full
+
+    -8 if a job after the first could not be expanded (out of memory)
 
 */
 int run_job(struct Job* job);
 
 /*
-Checks for any zombie children of current proccess and cleans them up, will loop untill
-there are no more zombies
+Starts every stage of a job without waiting for it or reporting it. Builtin
+stages run in forked copies of the shell, except that a foreground pipeline
+without job control may run one data moving builtin (cat, tee) in the shell
+itself before this returns
+
+job - pointer to Job structure containing job to start
+foreground - 1 to start the job as the owner of the terminal (job control only),
+             the caller must then wait for it with wait_for_job
+started - set to the job table entry of the job if successful
+
+Return:
+    0 if successful, with the entry neither waited for nor in the background
+    the negative values of run_job, in which case no entry is left in the table
+*/
+int start_job(struct Job* job, int foreground, struct JobEntry** started);
+
+/*
+Returns the exit status of the most recent job: the status of its last stage,
+128 plus the signal number if that stage was killed, 127 if its program could
+not be executed, 0 for background jobs and 1 if the shell failed to run the job
+
+No arguments
 
-No arguments or return values
+Returns:
+    the exit status of the most recent job
 */
-void check_for_zombies();
+int last_exit_status();
 
 #endif
\ No newline at end of file
@@ -0,0 +1,147 @@
+#include "scan.h"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SCAN_X86 1
+#include <immintrin.h>
+#endif
+
+/* 1 for every byte that ends a word, must match the non CC_WORD bytes of parsejob.c */
+static const unsigned char specialByte[256] = {
+    ['\0'] = 1, ['\t'] = 1, ['\n'] = 1, [' '] = 1,
+    ['|'] = 1, ['<'] = 1, ['>'] = 1, ['&'] = 1, [';'] = 1,
+    ['\''] = 1, ['"'] = 1, ['\\'] = 1,
+};
+
+
+/* Scalar scanner, also used for the tail shorter than a vector
+
+p - the first byte to look at
+end - one past the last byte that may be read
+
+Returns:
+    a pointer to the first special byte, or end
+*/
+static const char *scan_scalar(const char *p, const char *end) {
+    while (p < end && !specialByte[(unsigned char)*p]) {
+        p += 1;
+    }
+    return p;
+}
+
+#ifdef SCAN_X86
+
+/* SSE2 scanner: compares 16 bytes against every special byte and
+ORs the results into one bitmask
+
+p - the first byte to look at
+end - one past the last byte that may be read
+
+Returns:
+    a pointer to the first special byte, or end
+*/
+static const char *scan_sse2(const char *p, const char *end) {
+    const __m128i nul = _mm_set1_epi8('\0');
+    const __m128i tab = _mm_set1_epi8('\t');
+    const __m128i newline = _mm_set1_epi8('\n');
+    const __m128i space = _mm_set1_epi8(' ');
+    const __m128i pipe = _mm_set1_epi8('|');
+    const __m128i less = _mm_set1_epi8('<');
+    const __m128i greater = _mm_set1_epi8('>');
+    const __m128i amp = _mm_set1_epi8('&');
+    const __m128i semi = _mm_set1_epi8(';');
+    const __m128i squote = _mm_set1_epi8('\'');
+    const __m128i dquote = _mm_set1_epi8('"');
+    const __m128i backslash = _mm_set1_epi8('\\');
+
+    // only whole vectors are loaded, so nothing past end is ever read
+    while (end - p >= 16) {
+        __m128i v = _mm_loadu_si128((const __m128i *)p);
+        __m128i hit = _mm_or_si128(
+            _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, nul), _mm_cmpeq_epi8(v, tab)),
+                         _mm_or_si128(_mm_cmpeq_epi8(v, newline), _mm_cmpeq_epi8(v, space))),
+            _mm_or_si128(
+                _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, pipe), _mm_cmpeq_epi8(v, less)),
+                             _mm_or_si128(_mm_cmpeq_epi8(v, greater), _mm_cmpeq_epi8(v, amp))),
+                _mm_or_si128(_mm_or_si128(_mm_cmpeq_epi8(v, squote), _mm_cmpeq_epi8(v, dquote)),
+                             _mm_or_si128(_mm_cmpeq_epi8(v, backslash), _mm_cmpeq_epi8(v, semi)))));
+        int mask = _mm_movemask_epi8(hit);
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 16;
+    }
+    return scan_scalar(p, end);
+}
+
+/* AVX2 scanner: the SSE2 method on 32 bytes at a time
+
+p - the first byte to look at
+end - one past the last byte that may be read
+
+Returns:
+    a pointer to the first special byte, or end
+*/
+__attribute__((target("avx2")))
+static const char *scan_avx2(const char *p, const char *end) {
+    const __m256i nul = _mm256_set1_epi8('\0');
+    const __m256i tab = _mm256_set1_epi8('\t');
+    const __m256i newline = _mm256_set1_epi8('\n');
+    const __m256i space = _mm256_set1_epi8(' ');
+    const __m256i pipe = _mm256_set1_epi8('|');
+    const __m256i less = _mm256_set1_epi8('<');
+    const __m256i greater = _mm256_set1_epi8('>');
+    const __m256i amp = _mm256_set1_epi8('&');
+    const __m256i semi = _mm256_set1_epi8(';');
+    const __m256i squote = _mm256_set1_epi8('\'');
+    const __m256i dquote = _mm256_set1_epi8('"');
+    const __m256i backslash = _mm256_set1_epi8('\\');
+
+    while (end - p >= 32) {
+        __m256i v = _mm256_loadu_si256((const __m256i *)p);
+        __m256i hit = _mm256_or_si256(
+            _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, nul), _mm256_cmpeq_epi8(v, tab)),
+                            _mm256_or_si256(_mm256_cmpeq_epi8(v, newline), _mm256_cmpeq_epi8(v, space))),
+            _mm256_or_si256(
+                _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, pipe), _mm256_cmpeq_epi8(v, less)),
+                                _mm256_or_si256(_mm256_cmpeq_epi8(v, greater), _mm256_cmpeq_epi8(v, amp))),
+                _mm256_or_si256(_mm256_or_si256(_mm256_cmpeq_epi8(v, squote), _mm256_cmpeq_epi8(v, dquote)),
+                                _mm256_or_si256(_mm256_cmpeq_epi8(v, backslash), _mm256_cmpeq_epi8(v, semi)))));
+        unsigned int mask = _mm256_movemask_epi8(hit);
+        if (mask != 0) {
+            return p + __builtin_ctz(mask);
+        }
+        p += 32;
+    }
+    return scan_sse2(p, end);
+}
+
+#endif
+
+const char *(*scan_word_end)(const char *p, const char *end) = scan_scalar;
+
+int scan_use(int kind) {
+    if (kind == SCAN_SCALAR) {
+        scan_word_end = scan_scalar;
+        return 0;
+    }
+#ifdef SCAN_X86
+    if (kind == SCAN_SSE2 && __builtin_cpu_supports("sse2")) {
+        scan_word_end = scan_sse2;
+        return 0;
+    }
+    if (kind == SCAN_AVX2 && __builtin_cpu_supports("avx2")) {
+        scan_word_end = scan_avx2;
+        return 0;
+    }
+#endif
+    return -1;
+}
+
+void scan_init() {
+#ifdef SCAN_X86
+    __builtin_cpu_init();
+#endif
+    if (scan_use(SCAN_AVX2) != 0 && scan_use(SCAN_SSE2) != 0) {
+        scan_use(SCAN_SCALAR);
+    }
+}
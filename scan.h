@@ -0,0 +1,38 @@
+#ifndef SCAN_H
+#define SCAN_H
+
+#define SCAN_SCALAR 0     /* one byte at a time through a lookup table */
+#define SCAN_SSE2   1     /* 16 bytes at a time, any x86-64 cpu */
+#define SCAN_AVX2   2     /* 32 bytes at a time, needs cpu support */
+
+/* Finds the end of the plain word characters starting at p: the first
+whitespace, null, newline, metacharacter (| < > & ;), quote or backslash.
+These are exactly the bytes parsejob.c does not classify as CC_WORD.
+
+p - the first byte to look at
+end - one past the last byte that may be read
+
+Returns:
+    a pointer to the first special byte
+    end if there is none
+*/
+extern const char *(*scan_word_end)(const char *p, const char *end);
+
+/* Picks the fastest scanner the cpu supports (checked with CPUID)
+
+Takes no arguments
+No return values
+*/
+void scan_init();
+
+/* Forces a particular scanner, for benchmarking
+
+kind - SCAN_SCALAR, SCAN_SSE2 or SCAN_AVX2
+
+Returns:
+    0 if the scanner is now in use
+    -1 if the cpu or build does not support it
+*/
+int scan_use(int kind);
+
+#endif
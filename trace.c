@@ -0,0 +1,193 @@
+#include "trace.h"
+#include "mystring.h"
+#include "launch.h"
+#include <stdlib.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <time.h>
+
+#define TRACE_LINE_MAX 512      /* longest single event line, the exec path is cut to fit */
+
+const char *traceOpenError = "Error: could not open trace file\n";
+
+/* One buffered event */
+struct TraceEvent
+{
+  int kind;                 /* TRACE_ phase constant */
+  long start;               /* nanoseconds the phase began */
+  long duration;            /* nanoseconds the phase took, 0 for an instant */
+  long arg;                 /* pid, job number or length */
+};
+
+static const char *eventNames[] = {"read", "parse", "job", "launch", "exec", "reap", "wait"};
+
+int traceEnabled = 0;
+static int traceFd = -1;
+static int traceFormat = TRACE_FORMAT_JSON;
+static pid_t tracePid;
+static struct TraceEvent events[TRACE_BUFFER_EVENTS];
+static unsigned int numEvents = 0;
+
+
+int trace_format_from_name(const char *name) {
+    if (name != NULL && mystrcmp(name, "chrome") == 0) {
+        return TRACE_FORMAT_CHROME;
+    }
+    return TRACE_FORMAT_JSON;
+}
+
+int trace_init(const char *path, int format) {
+    traceFd = launch_shell_fd(open(path, O_WRONLY | O_CREAT | O_APPEND | O_CLOEXEC, 0644));
+    if (traceFd == -1) {
+        write(1, traceOpenError, 33);
+        return -1;
+    }
+    traceFormat = format;
+    tracePid = getpid();
+    if (format == TRACE_FORMAT_CHROME && lseek(traceFd, 0, SEEK_END) == 0) {
+        // the viewer accepts an array left unclosed, so events can keep being appended
+        write(traceFd, "[\n", 2);
+    }
+    traceEnabled = 1;
+    atexit(trace_flush);
+    return 0;
+}
+
+long trace_now() {
+    struct timespec now;
+
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return now.tv_sec * 1000000000L + now.tv_nsec;
+}
+
+/* Appends a text to a line being built
+
+line - the line
+pos - where the text goes
+text - the null terminated text
+
+Returns:
+    the position after the text
+*/
+static int append(char *line, int pos, const char *text) {
+    while (*text != '\0') {
+        line[pos++] = *text++;
+    }
+    return pos;
+}
+
+/* Appends a time in nanoseconds as microseconds with three decimals, e.g. "1204.518"
+
+line - the line
+pos - where the time goes
+nanoseconds - the time
+
+Returns:
+    the position after the time
+*/
+static int append_micros(char *line, int pos, long nanoseconds) {
+    pos += myitoa(nanoseconds / 1000, line + pos);
+    line[pos++] = '.';
+    line[pos++] = '0' + nanoseconds / 100 % 10;
+    line[pos++] = '0' + nanoseconds / 10 % 10;
+    line[pos++] = '0' + nanoseconds % 10;
+    return pos;
+}
+
+/* Formats one event in the trace format, e.g.
+{"name":"launch","ts":81234567890,"dur":61234,"pid":4120,"arg":4133}
+
+line - where the event is written, TRACE_LINE_MAX characters
+event - the event
+pid - the process that recorded it
+path - program path for an exec event, NULL for none
+
+Returns:
+    the number of characters written, ending in '\n'
+*/
+static int format_event(char *line, const struct TraceEvent *event, pid_t pid, const char *path) {
+    int pos = 0;
+
+    pos = append(line, pos, "{\"name\":\"");
+    pos = append(line, pos, eventNames[event->kind]);
+    if (traceFormat == TRACE_FORMAT_CHROME) {
+        pos = append(line, pos, event->duration == 0 ? "\",\"ph\":\"i\",\"s\":\"t\",\"ts\":" : "\",\"ph\":\"X\",\"ts\":");
+        pos = append_micros(line, pos, event->start);
+        if (event->duration != 0) {
+            pos = append(line, pos, ",\"dur\":");
+            pos = append_micros(line, pos, event->duration);
+        }
+        pos = append(line, pos, ",\"pid\":");
+        pos += myitoa(pid, line + pos);
+        pos = append(line, pos, ",\"tid\":");
+        pos += myitoa(pid, line + pos);
+        pos = append(line, pos, ",\"args\":{\"arg\":");
+    } else {
+        pos = append(line, pos, "\",\"ts\":");
+        pos += myitoa(event->start, line + pos);
+        pos = append(line, pos, ",\"dur\":");
+        pos += myitoa(event->duration, line + pos);
+        pos = append(line, pos, ",\"pid\":");
+        pos += myitoa(pid, line + pos);
+        pos = append(line, pos, ",\"arg\":");
+    }
+    pos += myitoa(event->arg, line + pos);
+    if (path != NULL) {
+        pos = append(line, pos, ",\"path\":\"");
+        // leave room for the closing characters, escaping what JSON requires
+        for (int i = 0; path[i] != '\0' && pos < TRACE_LINE_MAX - 16; i++) {
+            if (path[i] == '"' || path[i] == '\\') {
+                line[pos++] = '\\';
+            }
+            line[pos++] = (unsigned char)path[i] < ' ' ? '?' : path[i];
+        }
+        line[pos++] = '"';
+    }
+    pos = append(line, pos, traceFormat == TRACE_FORMAT_CHROME ? "}},\n" : "}\n");
+    return pos;
+}
+
+void trace_span(int kind, long start, long arg) {
+    if (numEvents == TRACE_BUFFER_EVENTS) {
+        trace_flush();
+    }
+    events[numEvents].kind = kind;
+    events[numEvents].start = start;
+    events[numEvents].duration = trace_now() - start;
+    events[numEvents].arg = arg;
+    // instants are recorded through here too, their few nanoseconds are noise
+    if (kind == TRACE_EXEC || kind == TRACE_REAP) {
+        events[numEvents].duration = 0;
+    }
+    numEvents += 1;
+}
+
+void trace_exec(const char *path) {
+    struct TraceEvent event = {TRACE_EXEC, trace_now(), 0, 0};
+    char line[TRACE_LINE_MAX];
+
+    // one write per line, so O_APPEND keeps it whole among the parent's lines
+    write(traceFd, line, format_event(line, &event, getpid(), path));
+}
+
+void trace_child() {
+    numEvents = 0;
+    tracePid = getpid();
+}
+
+void trace_flush() {
+    char block[TRACE_LINE_MAX * 16];
+    int pos = 0;
+
+    for (unsigned int i = 0; i < numEvents; i++) {
+        if (pos > (int)sizeof(block) - TRACE_LINE_MAX) {
+            write(traceFd, block, pos);
+            pos = 0;
+        }
+        pos += format_event(block + pos, &events[i], tracePid, NULL);
+    }
+    if (pos > 0) {
+        write(traceFd, block, pos);
+    }
+    numEvents = 0;
+}
@@ -0,0 +1,96 @@
+#ifndef TRACE_H
+#define TRACE_H
+
+#define TRACE_FORMAT_JSON   0    /* one JSON object per line, times in nanoseconds */
+#define TRACE_FORMAT_CHROME 1    /* Chrome trace-event array, times in microseconds */
+
+#define TRACE_BUFFER_EVENTS 4096 /* events held in memory before they are written out */
+
+/* Phases of the shell that are timed when tracing is on */
+#define TRACE_READ   0           /* get_job waiting for and reading a line */
+#define TRACE_PARSE  1           /* parse_job turning the line into a job */
+#define TRACE_JOB    2           /* run_job, from the first stage starting to the job being waited for */
+#define TRACE_LAUNCH 3           /* one fork or posix_spawn of a stage, arg is the child's pid */
+#define TRACE_EXEC   4           /* a forked child about to execve, written by the child itself */
+#define TRACE_REAP   5           /* one process reaped by wait4, arg is its pid */
+#define TRACE_WAIT   6           /* wait_for_job blocking on a job, arg is its job number */
+
+/* 1 while tracing is on. Tested before every call below, so a shell that
+is not tracing pays one load and branch per traced phase */
+extern int traceEnabled;
+
+/* Current time for a span, 0 without a clock read when tracing is off */
+#define TRACE_START() (traceEnabled ? trace_now() : 0)
+
+/* Records a phase that began at start (from TRACE_START) and ends now */
+#define TRACE_SPAN(kind, start, arg) do { if (traceEnabled) trace_span(kind, start, arg); } while (0)
+
+/* Records a moment with no duration */
+#define TRACE_INSTANT(kind, arg) do { if (traceEnabled) trace_span(kind, trace_now(), arg); } while (0)
+
+/* Opens the trace file and turns tracing on. Events are buffered and
+written out when the buffer fills and when the shell exits
+
+path - the file to append events to
+format - TRACE_FORMAT_JSON or TRACE_FORMAT_CHROME
+
+Returns:
+    0 if successful
+    -1 if the file could not be opened (tracing stays off)
+*/
+int trace_init(const char *path, int format);
+
+/* Converts the name of a trace format into its constant
+
+name - "json" or "chrome", may be NULL
+
+Returns:
+    TRACE_FORMAT_CHROME if name is "chrome"
+    TRACE_FORMAT_JSON for anything else, including NULL
+*/
+int trace_format_from_name(const char *name);
+
+/* Reads the clock used for every event
+
+Takes no arguments
+
+Returns:
+    CLOCK_MONOTONIC time in nanoseconds
+*/
+long trace_now();
+
+/* Adds an event to the buffer, writing the buffer out first if it is full
+
+kind - one of the TRACE_ phase constants
+start - when the phase began, from trace_now
+arg - pid, job number or length the event is about
+
+No return values
+*/
+void trace_span(int kind, long start, long arg);
+
+/* Writes an exec event for the calling process straight to the trace file.
+Used by forked children just before execve, whose buffer would be lost
+
+path - the program about to be executed
+
+No return values
+*/
+void trace_exec(const char *path);
+
+/* Drops the events a forked copy of the shell inherited from its parent,
+which the parent will write itself, and records its own pid for new events
+
+Takes no arguments
+No return values
+*/
+void trace_child();
+
+/* Writes out every buffered event
+
+Takes no arguments
+No return values
+*/
+void trace_flush();
+
+#endif